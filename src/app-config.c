@@ -27,6 +27,8 @@
 #include "app-config.h"
 
 #include <libfm/fm-gtk.h>
+#include <glib/gstdio.h>
+#include <gio/gunixmounts.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -42,9 +44,301 @@ typedef struct
     gboolean changed;
 } FmFolderConfig;
 
+/* Settings of folders which have no .directory file are kept in the file
+   dir-settings.conf of the profile. It may contain tens of thousands of
+   entries so it is loaded only when first needed and changes are appended
+   as records to dir-settings.journal instead of rewriting whole file. Each
+   record is a complete group so replaying it is idempotent. The journal
+   is merged back into dir-settings.conf in background once it grows. */
+
+/* journal is compacted when it is bigger than that and than 1/4 of cache */
+#define FC_JOURNAL_MIN_SIZE (16 * 1024)
+
 static GKeyFile *fc_cache = NULL;
+static char *fc_dir = NULL; /* profile directory */
+static gsize fc_cache_size = 0; /* size of dir-settings.conf */
+
+static GString *fc_journal = NULL; /* records not written yet */
+static gsize fc_journal_size = 0; /* size of dir-settings.journal */
+static guint fc_journal_serial = 0; /* incremented on each write */
+
+static guint fc_compact_idle = 0;
+static gboolean fc_pruning = FALSE; /* entries are tested in thread now */
+static char *fc_snapshot = NULL; /* data being written to dir-settings.conf */
+static guint fc_snapshot_serial = 0;
+
+static void _fc_replay_journal(const char *path)
+{
+    char *data, *line, *next, *end, *group = NULL;
+    gsize len;
+
+    if (!g_file_get_contents(path, &data, &len, NULL))
+        return;
+    fc_journal_size = len;
+    for (line = data; *line; line = next)
+    {
+        next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        else
+            next = line + strlen(line);
+        if (line[0] == '[')
+        {
+            /* start of record: the group is replaced completely */
+            end = strrchr(line, ']');
+            group = NULL;
+            if (end == NULL)
+                continue;
+            *end = '\0';
+            group = &line[1];
+            g_key_file_remove_group(fc_cache, group, NULL);
+        }
+        else if (group && (end = strchr(line, '=')))
+        {
+            *end = '\0';
+            g_key_file_set_value(fc_cache, group, line, &end[1]);
+        }
+    }
+    g_free(data);
+}
+
+static void _fc_queue_compact(void);
+
+static GKeyFile *_get_fc_cache(void)
+{
+    char *path;
+    struct stat st;
+
+    if (fc_cache)
+        return fc_cache;
+    fc_cache = g_key_file_new();
+    if (fc_dir == NULL) /* profile isn't loaded */
+        return fc_cache;
+    path = g_build_filename(fc_dir, "dir-settings.conf", NULL);
+    if (g_stat(path, &st) == 0)
+        fc_cache_size = st.st_size;
+    g_key_file_load_from_file(fc_cache, path, 0, NULL);
+    g_free(path);
+    path = g_build_filename(fc_dir, "dir-settings.journal", NULL);
+    _fc_replay_journal(path);
+    g_free(path);
+    _fc_queue_compact();
+    return fc_cache;
+}
+
+/* adds current state of @group into journal */
+static void _fc_journal_add(const char *group)
+{
+    char **keys;
+    char *value;
+    gsize i;
+
+    if (fc_journal == NULL)
+        fc_journal = g_string_sized_new(256);
+    g_string_append_printf(fc_journal, "[%s]\n", group);
+    /* purged group is written as empty record */
+    keys = g_key_file_get_keys(fc_cache, group, NULL, NULL);
+    for (i = 0; keys && keys[i]; i++)
+    {
+        value = g_key_file_get_value(fc_cache, group, keys[i], NULL);
+        if (value)
+            g_string_append_printf(fc_journal, "%s=%s\n", keys[i], value);
+        g_free(value);
+    }
+    g_strfreev(keys);
+}
+
+static void on_fc_snapshot_written(GObject *gf, GAsyncResult *res, gpointer path)
+{
+    GError *error = NULL;
+
+    if (g_file_replace_contents_finish(G_FILE(gf), res, NULL, &error))
+    {
+        fc_cache_size = strlen(fc_snapshot);
+        /* if nothing was appended while writing then journal is obsolete,
+           otherwise keep it, replaying it over snapshot is harmless */
+        if (fc_snapshot_serial == fc_journal_serial)
+        {
+            g_unlink(path);
+            fc_journal_size = 0;
+        }
+    }
+    else
+    {
+        g_warning("cannot save folder settings: %s", error->message);
+        g_error_free(error);
+    }
+    g_free(fc_snapshot);
+    fc_snapshot = NULL;
+    g_free(path);
+}
+
+static void _fc_write_snapshot(void)
+{
+    char *path;
+    GFile *gf;
+    gsize len;
+
+    /* write snapshot, old file is replaced only when it's complete */
+    fc_snapshot = g_key_file_to_data(fc_cache, &len, NULL);
+    if (fc_snapshot == NULL)
+        return;
+    fc_snapshot_serial = fc_journal_serial;
+    path = g_build_filename(fc_dir, "dir-settings.conf", NULL);
+    gf = g_file_new_for_path(path);
+    g_free(path);
+    g_file_replace_contents_async(gf, fc_snapshot, len, NULL, FALSE,
+                                  G_FILE_CREATE_PRIVATE, NULL,
+                                  on_fc_snapshot_written,
+                                  g_build_filename(fc_dir, "dir-settings.journal", NULL));
+    g_object_unref(gf);
+}
+
+/* Entries of folders which don't exist anymore are dropped on compaction.
+   Testing them may block on slow or dead mounts so it's done in a thread.
+   Folders on known media are kept while the media isn't mounted. */
+
+typedef struct
+{
+    char **groups; /* all groups of cache */
+    GPtrArray *gone; /* groups to drop */
+    guint serial; /* journal serial when test was started */
+} FmFolderConfigPrune;
+
+/* directories where udisks mounts removable media */
+static const char *removable_roots[] = { "/media/", "/run/media/", NULL };
+
+/* returns TRUE if @path is @dir or is inside of it */
+static gboolean _is_under(const char *path, const char *dir)
+{
+    gsize len = strlen(dir);
+
+    return (strncmp(path, dir, len) == 0 &&
+            (path[len] == '\0' || path[len] == '/' || dir[len-1] == '/'));
+}
+
+/* returns TRUE if @path is on media which is known but not mounted now;
+   called in worker thread */
+static gboolean _fc_is_on_absent_mount(const char *path, GHashTable *mounted,
+                                       GList *mount_points)
+{
+    char *dir, *parent;
+    gboolean absent = TRUE;
+    int i;
+
+    /* mount points from fstab */
+    for (; mount_points; mount_points = mount_points->next)
+    {
+        const char *mp = g_unix_mount_point_get_mount_path(mount_points->data);
+
+        if (strcmp(mp, "/") != 0 && _is_under(path, mp) &&
+            !g_hash_table_lookup_extended(mounted, mp, NULL, NULL))
+            return TRUE;
+    }
+    /* removable media, it's absent if no folder above is mounted */
+    for (i = 0; removable_roots[i]; i++)
+    {
+        if (!_is_under(path, removable_roots[i]))
+            continue;
+        dir = g_strdup(path);
+        while (absent && strlen(dir) > strlen(removable_roots[i]))
+        {
+            if (g_hash_table_lookup_extended(mounted, dir, NULL, NULL))
+                absent = FALSE;
+            parent = g_path_get_dirname(dir);
+            g_free(dir);
+            dir = parent;
+        }
+        g_free(dir);
+        return absent;
+    }
+    return FALSE;
+}
+
+static gboolean on_fc_pruned(gpointer user_data);
+
+static void _fc_prune_thread(gpointer data, gpointer unused)
+{
+    FmFolderConfigPrune *job = data;
+    GHashTable *mounted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GList *mounts, *mount_points, *l;
+    const char *group;
+    char *parent;
+    guint i;
+
+    /* take snapshot of mounts once for all entries */
+    mounts = g_unix_mounts_get(NULL);
+    for (l = mounts; l; l = l->next)
+    {
+        g_hash_table_insert(mounted, g_strdup(g_unix_mount_get_mount_path(l->data)), NULL);
+        g_unix_mount_free(l->data);
+    }
+    g_list_free(mounts);
+    mount_points = g_unix_mount_points_get(NULL);
+    for (i = 0; (group = job->groups[i]) != NULL; i++)
+    {
+        if (group[0] != '/' || _fc_is_on_absent_mount(group, mounted, mount_points) ||
+            g_file_test(group, G_FILE_TEST_EXISTS))
+            continue;
+        /* if parent folder is gone as well then it might be some media
+           mounted not by udisks so keep it */
+        parent = g_path_get_dirname(group);
+        if (g_file_test(parent, G_FILE_TEST_IS_DIR))
+            g_ptr_array_add(job->gone, (gpointer)group);
+        g_free(parent);
+    }
+    g_list_free_full(mount_points, (GDestroyNotify)g_unix_mount_point_free);
+    g_hash_table_destroy(mounted);
+    gdk_threads_add_idle(on_fc_pruned, job);
+}
+
+static gboolean on_fc_pruned(gpointer user_data)
+{
+    FmFolderConfigPrune *job = user_data;
+    guint i;
+
+    fc_pruning = FALSE;
+    if (fc_cache)
+    {
+        /* entries might be saved again while testing, skip pruning then */
+        if (job->serial == fc_journal_serial)
+            for (i = 0; i < job->gone->len; i++)
+                g_key_file_remove_group(fc_cache, g_ptr_array_index(job->gone, i), NULL);
+        _fc_write_snapshot();
+    }
+    g_ptr_array_free(job->gone, TRUE);
+    g_strfreev(job->groups);
+    g_slice_free(FmFolderConfigPrune, job);
+    return FALSE;
+}
+
+static gboolean on_fc_compact_idle(gpointer unused)
+{
+    static GThreadPool *pool = NULL;
+    FmFolderConfigPrune *job;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    fc_compact_idle = 0;
+    if (pool == NULL)
+        pool = g_thread_pool_new(_fc_prune_thread, NULL, 1, FALSE, NULL);
+    job = g_slice_new(FmFolderConfigPrune);
+    job->groups = g_key_file_get_groups(fc_cache, NULL);
+    job->gone = g_ptr_array_new();
+    job->serial = fc_journal_serial;
+    fc_pruning = TRUE;
+    g_thread_pool_push(pool, job, NULL);
+    return FALSE;
+}
 
-static gboolean dir_cache_changed = FALSE;
+static void _fc_queue_compact(void)
+{
+    if (fc_compact_idle || fc_pruning || fc_snapshot || fc_dir == NULL ||
+        fc_journal_size < MAX(FC_JOURNAL_MIN_SIZE, fc_cache_size / 4))
+        return;
+    fc_compact_idle = gdk_threads_add_idle_full(G_PRIORITY_LOW, on_fc_compact_idle,
+                                                NULL, NULL);
+}
 
 static FmFolderConfig *fm_folder_config_open(FmPath *path)
 {
@@ -52,11 +346,13 @@ static FmFolderConfig *fm_folder_config_open(FmPath *path)
     FmPath *sub_path;
 
     fc->changed = FALSE;
-    /* clear .directory file first */
+    /* clear .directory file first; don't test it on remote paths since
+       that may block on network, those are kept in cache only; missing
+       file just fails to load so there is no need to test it first */
     sub_path = fm_path_new_child(path, ".directory");
     fc->filepath = fm_path_to_str(sub_path);
     fm_path_unref(sub_path);
-    if (g_file_test(fc->filepath, G_FILE_TEST_EXISTS))
+    if (fm_path_is_native(path))
     {
         fc->kf = g_key_file_new();
         if (g_key_file_load_from_file(fc->kf, fc->filepath,
@@ -72,7 +368,7 @@ static FmFolderConfig *fm_folder_config_open(FmPath *path)
     g_free(fc->filepath);
     fc->filepath = NULL;
     fc->group = fm_path_to_str(path);
-    fc->kf = fc_cache;
+    fc->kf = _get_fc_cache();
     return fc;
 }
 
@@ -99,8 +395,8 @@ static gboolean fm_folder_config_close(FmFolderConfig *fc, GError **error)
     {
         if (fc->changed)
         {
-            /* raise 'changed' flag and schedule config save */
-            dir_cache_changed = TRUE;
+            /* add journal record and schedule config save */
+            _fc_journal_add(fc->group);
             pcmanfm_save_config(FALSE);
         }
         g_free(fc->group);
@@ -186,50 +482,29 @@ static void fm_folder_config_purge(FmFolderConfig *fc)
 
 static void fm_folder_config_save_cache(const char *dir_path)
 {
-    char *path, *path2, *path3;
-    char *out;
-    gsize len;
+    char *path;
+    FILE *f;
 
     /* if per-directory cache was changed since last invocation then save it */
-    if (dir_cache_changed)
+    if (fc_journal == NULL || fc_journal->len == 0)
+        return;
+    path = g_build_filename(dir_path, "dir-settings.journal", NULL);
+    f = fopen(path, "a");
+    if (f && fwrite(fc_journal->str, 1, fc_journal->len, f) == fc_journal->len &&
+        fclose(f) == 0)
     {
-        out = g_key_file_to_data(fc_cache, &len, NULL);
-        if (out)
-        {
-            /* create temp file with settings */
-            path = g_build_filename(dir_path, "dir-settings.conf", NULL);
-            path2 = g_build_filename(dir_path, "dir-settings.tmp", NULL);
-            path3 = g_build_filename(dir_path, "dir-settings.backup", NULL);
-            /* do safe replace now, the file is important enough to be lost */
-            if (g_file_set_contents(path2, out, len, NULL))
-            {
-                /* backup old cache file */
-                g_unlink(path3);
-                if (!g_file_test(path, G_FILE_TEST_EXISTS) ||
-                    g_rename(path, path3) == 0)
-                {
-                    /* rename temp file */
-                    if (g_rename(path2, path) == 0)
-                    {
-                        /* success! remove the old cache file */
-                        g_unlink(path3);
-                        /* reset the 'changed' flag */
-                        dir_cache_changed = FALSE;
-                    }
-                    else
-                        g_warning("cannot rename %s to %s", path2, path);
-                }
-                else
-                    g_warning("cannot rename %s to %s", path, path3);
-            }
-            else
-                g_warning("cannot save %s", path2);
-            g_free(path);
-            g_free(path2);
-            g_free(path3);
-            g_free(out);
-        }
+        fc_journal_size += fc_journal->len;
+        fc_journal_serial++;
+        g_string_truncate(fc_journal, 0);
+        _fc_queue_compact();
+    }
+    else
+    {
+        if (f)
+            fclose(f);
+        g_warning("cannot save %s", path);
     }
+    g_free(path);
 }
 #endif /* LibFM < 1.2.0 */
 
@@ -416,6 +691,150 @@ static gboolean _parse_config_for_path(FmFolderConfig *fc,
 }
 
 
+/* ---------------------------------------------------------------------
+    Cache of per-folder config lookups */
+
+/* seconds after which .directory file of native folder is checked again */
+#define PATH_CONFIG_CACHE_TTL 10
+/* max number of folders to remember */
+#define PATH_CONFIG_CACHE_MAX 1024
+
+typedef struct
+{
+    gint64 checked; /* monotonic time of last check */
+    gboolean changed; /* config was changed, entry should be read again */
+    time_t mtime; /* of .directory file, 0 if there is none */
+    gboolean own_config; /* FALSE if defaults should be used */
+    /* fields below are only valid if own_config is TRUE */
+#if FM_CHECK_VERSION(1, 0, 2)
+    FmSortMode mode;
+    FmFolderModelCol by; /* FM_FOLDER_MODEL_COL_DEFAULT if not set */
+#else
+    GtkSortType mode;
+    gint by; /* -1 if not set */
+#endif
+    FmStandardViewMode view_mode; /* -1 if not set */
+    gboolean show_hidden; /* -1 if not set */
+    char **columns; /* NULL if not set */
+} PathConfig;
+
+static GHashTable *path_config_cache = NULL; /* FmPath -> PathConfig */
+
+static void path_config_free(gpointer data)
+{
+    PathConfig *pc = data;
+
+    g_strfreev(pc->columns);
+    g_slice_free(PathConfig, pc);
+}
+
+static time_t _get_dir_config_mtime(FmPath *path)
+{
+    char *dir = fm_path_to_str(path);
+    char *file = g_build_filename(dir, ".directory", NULL);
+    struct stat st;
+    time_t mtime = 0;
+
+    if (g_stat(file, &st) == 0)
+        mtime = st.st_mtime;
+    g_free(file);
+    g_free(dir);
+    return mtime;
+}
+
+/* returns cached entry for @path if it is still valid. Remote paths never
+   expire since their config is kept in our own cache and we know when it
+   is changed; for native path we check if .directory file was changed,
+   and if it was then its new time is returned in @mtime so it should not
+   be tested again; @mtime is set to -1 if it was not tested */
+static PathConfig *_lookup_path_config(FmPath *path, time_t *mtime)
+{
+    PathConfig *pc;
+    gint64 now;
+
+    *mtime = -1;
+    if (path_config_cache == NULL)
+        return NULL;
+    pc = g_hash_table_lookup(path_config_cache, path);
+    if (pc == NULL || (!pc->changed && !fm_path_is_native(path)))
+        return pc;
+    now = g_get_monotonic_time();
+    if (!pc->changed && now - pc->checked < PATH_CONFIG_CACHE_TTL * G_USEC_PER_SEC)
+        return pc;
+    if (!pc->changed)
+        *mtime = _get_dir_config_mtime(path);
+    if (pc->changed || *mtime != pc->mtime)
+    {
+        g_hash_table_remove(path_config_cache, path);
+        return NULL;
+    }
+    pc->checked = now;
+    return pc;
+}
+
+/* adds new entry for @path, @mtime is one returned by _lookup_path_config() */
+static PathConfig *_add_path_config(FmPath *path, time_t mtime)
+{
+    PathConfig *pc = g_slice_new(PathConfig);
+
+    if (path_config_cache == NULL)
+        path_config_cache = g_hash_table_new_full((GHashFunc)fm_path_hash,
+                                                  (GEqualFunc)fm_path_equal,
+                                                  (GDestroyNotify)fm_path_unref,
+                                                  path_config_free);
+    else if (g_hash_table_size(path_config_cache) >= PATH_CONFIG_CACHE_MAX)
+        g_hash_table_remove_all(path_config_cache);
+    pc->checked = g_get_monotonic_time();
+    pc->changed = FALSE;
+    if (!fm_path_is_native(path))
+        mtime = 0;
+    else if (mtime < 0)
+        mtime = _get_dir_config_mtime(path);
+    pc->mtime = mtime;
+    pc->own_config = FALSE;
+    pc->mode = 0;
+#if FM_CHECK_VERSION(1, 0, 2)
+    pc->by = FM_FOLDER_MODEL_COL_DEFAULT;
+#else
+    pc->by = -1;
+#endif
+    pc->view_mode = -1;
+    pc->show_hidden = -1;
+    pc->columns = NULL;
+    g_hash_table_replace(path_config_cache, fm_path_ref(path), pc);
+    return pc;
+}
+
+/**
+ * fm_app_config_invalidate_config_for_path
+ * @path: path which config was changed
+ *
+ * Marks cached configuration of @path so it will be read again next time.
+ * Should be called if '.directory' file of @path was changed externally.
+ * The entry is not freed right away since columns list returned by
+ * fm_app_config_get_config_for_path() may be still in use by the caller.
+ */
+void fm_app_config_invalidate_config_for_path(FmPath *path)
+{
+    GHashTableIter it;
+    PathConfig *pc;
+
+    if (path_config_cache == NULL)
+        return;
+    /* remote paths may inherit config of their scheme so mark them all */
+    if (fm_path_is_native(path))
+    {
+        pc = g_hash_table_lookup(path_config_cache, path);
+        if (pc)
+            pc->changed = TRUE;
+        return;
+    }
+    g_hash_table_iter_init(&it, path_config_cache);
+    while (g_hash_table_iter_next(&it, NULL, (gpointer *)&pc))
+        pc->changed = TRUE;
+}
+
+
 static void fm_app_config_finalize              (GObject *object);
 
 G_DEFINE_TYPE(FmAppConfig, fm_app_config, FM_CONFIG_TYPE);
@@ -458,9 +877,25 @@ static void fm_app_config_finalize(GObject *object)
     g_hash_table_unref(cfg->autorun_choices);
 
 #if !FM_CHECK_VERSION(1, 2, 0)
-    g_key_file_free(fc_cache);
+    if (fc_compact_idle)
+    {
+        g_source_remove(fc_compact_idle);
+        fc_compact_idle = 0;
+    }
+    if (fc_cache)
+        g_key_file_free(fc_cache);
     fc_cache = NULL;
+    if (fc_journal)
+        g_string_free(fc_journal, TRUE);
+    fc_journal = NULL;
+    g_free(fc_dir);
+    fc_dir = NULL;
 #endif
+    if (path_config_cache)
+    {
+        g_hash_table_destroy(path_config_cache);
+        path_config_cache = NULL;
+    }
 
 #if FM_CHECK_VERSION(1, 2, 0)
     g_free(cfg->home_path);
@@ -530,9 +965,18 @@ static void fm_app_config_init(FmAppConfig *cfg)
 #if FM_CHECK_VERSION(1, 2, 0)
     cfg->home_path = NULL;
     cfg->focus_previous = FALSE;
+    cfg->fuzzy_sort = FALSE;
+    cfg->listing_cache_max = 64;
+    cfg->listing_cache_size = 32768;
 #endif
     cfg->change_tab_on_drop = TRUE;
     cfg->close_on_unmount = TRUE;
+    cfg->deep_count_cache = FALSE;
+    cfg->prefetch_folders = 8;
+    cfg->prefetch_files = 50000;
+    cfg->restore_session = FALSE;
+    cfg->detach_hidden_tabs = 0;
+    cfg->history_snapshot_files = 20000;
     cfg->maximized = FALSE;
     cfg->pathbar_mode_buttons = FALSE;
 }
@@ -691,9 +1135,18 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
     fm_key_file_get_bool(kf, "ui", "desktop_folder_new_win", &cfg->desktop_folder_new_win);
     fm_key_file_get_bool(kf, "ui", "change_tab_on_drop", &cfg->change_tab_on_drop);
     fm_key_file_get_bool(kf, "ui", "close_on_unmount", &cfg->close_on_unmount);
+    fm_key_file_get_bool(kf, "ui", "deep_count_cache", &cfg->deep_count_cache);
+    fm_key_file_get_int(kf, "ui", "prefetch_folders", &cfg->prefetch_folders);
+    fm_key_file_get_int(kf, "ui", "prefetch_files", &cfg->prefetch_files);
+    fm_key_file_get_bool(kf, "ui", "restore_session", &cfg->restore_session);
+    fm_key_file_get_int(kf, "ui", "detach_hidden_tabs", &cfg->detach_hidden_tabs);
+    fm_key_file_get_int(kf, "ui", "history_snapshot_files", &cfg->history_snapshot_files);
 
 #if FM_CHECK_VERSION(1, 2, 0)
     fm_key_file_get_bool(kf, "ui", "focus_previous", &cfg->focus_previous);
+    fm_key_file_get_bool(kf, "ui", "fuzzy_sort", &cfg->fuzzy_sort);
+    fm_key_file_get_int(kf, "ui", "listing_cache_max", &cfg->listing_cache_max);
+    fm_key_file_get_int(kf, "ui", "listing_cache_size", &cfg->listing_cache_size);
     tmp_int = FM_SP_NONE;
     tmpv = g_key_file_get_string_list(kf, "ui", "side_pane_mode", NULL, NULL);
     if (tmpv)
@@ -849,11 +1302,9 @@ void fm_app_config_load_from_profile(FmAppConfig* cfg, const char* name)
     g_key_file_free(kf);
 
 #if !FM_CHECK_VERSION(1, 2, 0)
-    fc_cache = g_key_file_new();
-    path = g_build_filename(g_get_user_config_dir(), "pcmanfm", name,
-                            "dir-settings.conf", NULL);
-    g_key_file_load_from_file(fc_cache, path, 0, NULL);
-    g_free(path);
+    /* dir-settings.conf is loaded when it's needed first time */
+    g_free(fc_dir);
+    fc_dir = g_build_filename(g_get_user_config_dir(), "pcmanfm", name, NULL);
 #endif
 }
 
@@ -881,7 +1332,8 @@ gboolean fm_app_config_get_config_for_path(FmPath *path, GtkSortType *mode,
 {
     FmPath *sub_path;
     FmFolderConfig *fc;
-    gboolean ret = TRUE;
+    PathConfig *pc;
+    time_t mtime;
 
     /* preload defaults */
     if (mode)
@@ -896,44 +1348,69 @@ gboolean fm_app_config_get_config_for_path(FmPath *path, GtkSortType *mode,
     if (columns)
         *columns = app_config->columns;
 #endif
-    fc = fm_folder_config_open(path);
-    if (!fm_folder_config_is_empty(fc))
-        _parse_config_for_path(fc, mode, by, view_mode, show_hidden, columns);
-    else if (!fm_path_is_native(path))
+    pc = _lookup_path_config(path, &mtime);
+    if (pc == NULL)
     {
-        /* if path is non-native then try the scheme */
+        /* parse config into cache entry, fields not set there stay unset */
+        pc = _add_path_config(path, mtime);
+        pc->own_config = TRUE;
+        fc = fm_folder_config_open(path);
+        if (!fm_folder_config_is_empty(fc))
+            _parse_config_for_path(fc, &pc->mode, &pc->by, &pc->view_mode,
+                                   &pc->show_hidden, &pc->columns);
+        else if (!fm_path_is_native(path))
+        {
+            /* if path is non-native then try the scheme */
 #if FM_CHECK_VERSION(1, 2, 0)
-        sub_path = fm_path_get_scheme_path(path);
+            sub_path = fm_path_get_scheme_path(path);
 #else
-        for (sub_path = path; fm_path_get_parent(sub_path) != NULL; )
-            sub_path = fm_path_get_parent(sub_path);
+            for (sub_path = path; fm_path_get_parent(sub_path) != NULL; )
+                sub_path = fm_path_get_parent(sub_path);
 #endif
-        fm_folder_config_close(fc, NULL);
-        fc = fm_folder_config_open(sub_path);
-        if (!fm_folder_config_is_empty(fc))
-            _parse_config_for_path(fc, mode, by, view_mode, show_hidden, columns);
-        /* if path is search://... then use predefined values */
-        else if (strncmp(fm_path_get_basename(sub_path), "search:", 7) == 0)
-        {
-            if (view_mode)
-                *view_mode = FM_FV_LIST_VIEW;
-            if (show_hidden)
-                *show_hidden = TRUE;
-#if FM_CHECK_VERSION(1, 0, 2)
-            if (columns)
+            fm_folder_config_close(fc, NULL);
+            fc = fm_folder_config_open(sub_path);
+            if (!fm_folder_config_is_empty(fc))
+                _parse_config_for_path(fc, &pc->mode, &pc->by, &pc->view_mode,
+                                       &pc->show_hidden, &pc->columns);
+            /* if path is search://... then use predefined values */
+            else if (strncmp(fm_path_get_basename(sub_path), "search:", 7) == 0)
             {
+#if FM_CHECK_VERSION(1, 0, 2)
                 static char *def[] = {"name", "desc", "dirname", "size", "mtime", NULL};
-                *columns = def;
-            }
+
+                pc->columns = g_strdupv(def);
 #endif
+                pc->mode = app_config->sort_type;
+                pc->view_mode = FM_FV_LIST_VIEW;
+                pc->show_hidden = TRUE;
+            }
+            else
+                pc->own_config = FALSE;
         }
         else
-            ret = FALSE;
+            pc->own_config = FALSE;
+        fm_folder_config_close(fc, NULL);
     }
-    else
-        ret = FALSE;
-    fm_folder_config_close(fc, NULL);
-    return ret;
+    if (!pc->own_config)
+        return FALSE;
+    /* apply cached values over defaults */
+    if (mode)
+        *mode = pc->mode;
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (by && pc->by != FM_FOLDER_MODEL_COL_DEFAULT)
+#else
+    if (by && pc->by >= 0)
+#endif
+        *by = pc->by;
+    if (view_mode && pc->view_mode != (FmStandardViewMode)-1)
+        *view_mode = pc->view_mode;
+    if (show_hidden && pc->show_hidden != -1)
+        *show_hidden = pc->show_hidden;
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (columns && pc->columns)
+        *columns = pc->columns;
+#endif
+    return TRUE;
 }
 
 /**
@@ -959,6 +1436,7 @@ void fm_app_config_save_config_for_path(FmPath *path, GtkSortType mode, gint by,
 
     if (path == NULL) /* it seem called too early and folder isn't loaded yet */
         return;
+    fm_app_config_invalidate_config_for_path(path);
     /* if path is search://... then use search: instead */
 #if FM_CHECK_VERSION(1, 2, 0)
     sub_path = fm_path_get_scheme_path(path);
@@ -1024,6 +1502,7 @@ void fm_app_config_clear_config_for_path(FmPath *path)
 
     fm_folder_config_purge(fc);
     fm_folder_config_close(fc, NULL);
+    fm_app_config_invalidate_config_for_path(path);
 #if FM_CHECK_VERSION(1, 2, 0)
     /* raise 'changed' flag and schedule config save */
     pcmanfm_save_config(FALSE);
@@ -1130,8 +1609,17 @@ void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
         g_string_append_printf(buf, "desktop_folder_new_win=%d\n", cfg->desktop_folder_new_win);
         g_string_append_printf(buf, "change_tab_on_drop=%d\n", cfg->change_tab_on_drop);
         g_string_append_printf(buf, "close_on_unmount=%d\n", cfg->close_on_unmount);
+        g_string_append_printf(buf, "deep_count_cache=%d\n", cfg->deep_count_cache);
+        g_string_append_printf(buf, "prefetch_folders=%d\n", cfg->prefetch_folders);
+        g_string_append_printf(buf, "prefetch_files=%d\n", cfg->prefetch_files);
+        g_string_append_printf(buf, "restore_session=%d\n", cfg->restore_session);
+        g_string_append_printf(buf, "detach_hidden_tabs=%d\n", cfg->detach_hidden_tabs);
+        g_string_append_printf(buf, "history_snapshot_files=%d\n", cfg->history_snapshot_files);
 #if FM_CHECK_VERSION(1, 2, 0)
         g_string_append_printf(buf, "focus_previous=%d\n", cfg->focus_previous);
+        g_string_append_printf(buf, "fuzzy_sort=%d\n", cfg->fuzzy_sort);
+        g_string_append_printf(buf, "listing_cache_max=%d\n", cfg->listing_cache_max);
+        g_string_append_printf(buf, "listing_cache_size=%d\n", cfg->listing_cache_size);
         g_string_append(buf, "side_pane_mode=");
         if (cfg->side_pane_mode & FM_SP_HIDE)
             g_string_append(buf, "hidden;");
@@ -126,7 +126,16 @@ struct _FmAppConfig
     gboolean close_on_unmount;
 #if FM_CHECK_VERSION(1, 2, 0)
     gboolean focus_previous;
+    gboolean fuzzy_sort; /* sort fuzzy filter results by match score */
+    gint listing_cache_max; /* max folder listings cached, 0 to disable */
+    gint listing_cache_size; /* max size of cached listings, in KiB */
 #endif
+    gboolean deep_count_cache; /* keep sizes of counted folders on disk */
+    gint prefetch_folders; /* max folders kept prefetched, 0 to disable */
+    gint prefetch_files; /* max files in all prefetched folders */
+    gboolean restore_session; /* reopen windows and tabs on start */
+    gint detach_hidden_tabs; /* seconds after which hidden tab drops its model, 0 to never */
+    gint history_snapshot_files; /* max files in models kept for back and forward, 0 to disable */
     gboolean maximized;
     gboolean pathbar_mode_buttons;
 
@@ -201,6 +210,7 @@ void fm_app_config_save_config_for_path(FmPath *path, GtkSortType mode, gint by,
                                         gboolean show_hidden, char **columns);
 #endif
 void fm_app_config_clear_config_for_path(FmPath *path);
+void fm_app_config_invalidate_config_for_path(FmPath *path);
 
 void fm_app_config_set_autorun_choice(FmAppConfig *cfg,
                                       const char *content_type,
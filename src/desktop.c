@@ -28,6 +28,7 @@
 #include "pcmanfm.h"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include <gdk/gdkx.h>
 #include <gdk/gdkkeysyms.h>
@@ -36,6 +37,7 @@
 #include <math.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <cairo-xlib.h>
 
@@ -57,6 +59,11 @@
 /* the search dialog timeout (in ms) */
 #define DESKTOP_SEARCH_DIALOG_TIMEOUT (5000)
 
+/* inserted rows are collected for one frame (in ms) before update */
+#define BATCH_FRAME_TIME 16
+/* if more items were added in a batch then don't notify AT on each one */
+#define ATK_BATCH_NOTIFY_MAX 32
+
 struct _FmDesktopItem
 {
     FmFileInfo* fi;
@@ -65,10 +72,11 @@ struct _FmDesktopItem
     GdkRectangle text_rect;
     gboolean is_special : 1; /* is this a special item like "My Computer", mounted volume, or "Trash" */
     gboolean is_mount : 1; /* is this a mounted volume*/
-    gboolean is_selected : 1;
+    gboolean is_selected : 1; /* use set_item_selected() to change it */
     gboolean is_rubber_banded : 1;
     gboolean is_prelight : 1;
     gboolean fixed_pos : 1;
+    GList *sel_link; /* link in the desktop->selected queue */
 };
 
 struct _FmBackgroundCache
@@ -86,6 +94,7 @@ struct _FmBackgroundCache
 
 static void queue_layout_items(FmDesktop* desktop);
 static void redraw_item(FmDesktop* desktop, FmDesktopItem* item);
+static void free_snapshot(FmDesktop* desktop);
 
 static FmFileInfoList* _dup_selected_files(FmFolderView* fv);
 static FmPathList* _dup_selected_file_paths(FmFolderView* fv);
@@ -115,6 +124,16 @@ static GdkCursor* hand_cursor = NULL;
 
 static guint idle_config_save = 0;
 
+/* desktop startup is done in phases, see fm_desktop_manager_init() */
+static gint64 startup_time = 0; /* 0 if startup is finished */
+static guint startup_generation = 0; /* to drop jobs of previous startup */
+static gint startup_wallpapers = 0; /* number of wallpapers being decoded */
+static gint startup_desktops = 0; /* number of desktops not drawn yet */
+static guint startup_timeout = 0; /* ends startup if something hangs */
+
+static void _startup_desktop_drawn(void);
+static void _startup_desktop_done(FmDesktop *desktop);
+
 enum {
 #if N_FM_DND_DEST_DEFAULT_TARGETS > N_FM_DND_SRC_DEFAULT_TARGETS
     FM_DND_DEST_DESKTOP_ITEM = N_FM_DND_DEST_DEFAULT_TARGETS
@@ -178,22 +197,38 @@ static GSList *mounts = NULL;
 /* ---------------------------------------------------------------------
     Items management and common functions */
 
-static char* get_config_file(FmDesktop* desktop, gboolean create_dir)
+/* returns index of @desktop in desktops list or -1 */
+static int get_desktop_index(FmDesktop* desktop)
 {
-    char *dir, *path;
     int i;
 
     for(i = 0; i < n_screens; i++)
         if(desktops[i] == desktop)
-            break;
-    if(i >= n_screens)
+            return i;
+    return -1;
+}
+
+static char* get_desktop_file(FmDesktop* desktop, gboolean create_dir,
+                              const char *name_template)
+{
+    char *dir, *name, *path;
+    int i = get_desktop_index(desktop);
+
+    if(i < 0)
         return NULL;
     dir = pcmanfm_get_profile_dir(create_dir);
-    path = g_strdup_printf("%s/desktop-items-%u.conf", dir, i);
+    name = g_strdup_printf(name_template, i);
+    path = g_build_filename(dir, name, NULL);
+    g_free(name);
     g_free(dir);
     return path;
 }
 
+static inline char* get_config_file(FmDesktop* desktop, gboolean create_dir)
+{
+    return get_desktop_file(desktop, create_dir, "desktop-items-%u.conf");
+}
+
 static inline FmDesktopItem* desktop_item_new(FmFolderModel* model, GtkTreeIter* it)
 {
     FmDesktopItem* item = g_slice_new0(FmDesktopItem);
@@ -225,6 +260,28 @@ static inline void desktop_item_free(FmDesktopItem* item)
     g_slice_free(FmDesktopItem, item);
 }
 
+/* selection is kept in the desktop->selected queue in order of selecting so
+   count and list of selected items are available without model walking */
+static void set_item_selected(FmDesktop* desktop, FmDesktopItem* item,
+                              gboolean selected)
+{
+    /* we cannot compare booleans, TRUE may be 1 or -1 */
+    if (selected)
+    {
+        if (item->is_selected)
+            return;
+        item->is_selected = TRUE;
+        g_queue_push_tail(&desktop->selected, item);
+        item->sel_link = desktop->selected.tail;
+    }
+    else if (item->is_selected)
+    {
+        item->is_selected = FALSE;
+        g_queue_delete_link(&desktop->selected, item->sel_link);
+        item->sel_link = NULL;
+    }
+}
+
 static void calc_item_size(FmDesktop* desktop, FmDesktopItem* item, GdkPixbuf* icon)
 {
     PangoRectangle rc2;
@@ -471,34 +528,16 @@ static void queue_config_save(FmDesktop *desktop)
 
 static GList* get_selected_items(FmDesktop* desktop, int* n_items)
 {
-    GList* items = NULL;
-    int n = 0;
-    FmDesktopItem* focus = NULL;
-    GtkTreeModel* model = desktop->model ? GTK_TREE_MODEL(desktop->model) : NULL;
-    GtkTreeIter it;
-    if(model && gtk_tree_model_get_iter_first(model, &it)) do
-    {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if(item->is_selected)
-        {
-            if(G_LIKELY(item != desktop->focus))
-            {
-                items = g_list_prepend(items, item);
-                ++n;
-            }
-            else
-                focus = item;
-        }
-    }
-    while(gtk_tree_model_iter_next(model, &it));
-    items = g_list_reverse(items);
-    if(focus)
+    GList* items = g_list_copy(desktop->selected.head);
+
+    /* focused item should be the first one */
+    if(desktop->focus && desktop->focus->is_selected && items->data != desktop->focus)
     {
-        items = g_list_prepend(items, focus);
-        ++n;
+        items = g_list_remove(items, desktop->focus);
+        items = g_list_prepend(items, desktop->focus);
     }
     if(n_items)
-        *n_items = n;
+        *n_items = desktop->selected.length;
     return items;
 }
 
@@ -1236,7 +1275,7 @@ static gboolean fm_desktop_accessible_add_selection(AtkSelection *selection, gin
     item = g_list_nth_data(priv->items, i);
     if (!item)
         return FALSE;
-    item->item->is_selected = TRUE;
+    set_item_selected(desktop, item->item, TRUE);
     redraw_item(desktop, item->item);
     atk_object_notify_state_change(ATK_OBJECT(item), ATK_STATE_SELECTED, TRUE);
     return TRUE;
@@ -1276,18 +1315,11 @@ static AtkObject *fm_desktop_accessible_ref_selection(AtkSelection *selection,
 
 static gint fm_desktop_accessible_get_selection_count(AtkSelection *selection)
 {
-    FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(selection);
-    FmDesktopItemAccessible *item;
-    GList *items;
-    gint i = 0;
+    GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(selection));
 
-    for (items = priv->items; items; items = items->next)
-    {
-        item = items->data;
-        if (item->item->is_selected)
-            i++;
-    }
-    return i;
+    if (widget == NULL)
+        return 0;
+    return FM_DESKTOP(widget)->selected.length;
 }
 
 static gboolean fm_desktop_accessible_is_child_selected(AtkSelection *selection,
@@ -1323,7 +1355,7 @@ static gboolean fm_desktop_accessible_remove_selection(AtkSelection *selection,
         if (item->item->is_selected)
             if (i-- == 0)
             {
-                item->item->is_selected = FALSE;
+                set_item_selected(desktop, item->item, FALSE);
                 redraw_item(desktop, item->item);
                 atk_object_notify_state_change(ATK_OBJECT(item), ATK_STATE_SELECTED, FALSE);
                 return TRUE;
@@ -1548,6 +1580,157 @@ static inline gint fm_desktop_accessible_index(GtkWidget *desktop, gpointer item
     return g_list_index(priv->items, item);
 }
 
+typedef struct
+{
+    gint index;
+    FmDesktopItem *item;
+} FmDesktopAtkAdded;
+
+static gint fm_desktop_atk_added_compare(gconstpointer a, gconstpointer b)
+{
+    return ((const FmDesktopAtkAdded *)a)->index - ((const FmDesktopAtkAdded *)b)->index;
+}
+
+/* notifies about inserted children: each child if there are only few of
+   them or else only once for whole batch, that is enough for AT to rescan */
+static void fm_desktop_accessible_notify_added(AtkObject *obj, GArray *indexes)
+{
+    guint i;
+
+    if (indexes->len > ATK_BATCH_NOTIFY_MAX)
+        g_signal_emit_by_name(obj, "visible-data-changed");
+    else for (i = 0; i < indexes->len; i++)
+        g_signal_emit_by_name(obj, "children-changed::add",
+                              g_array_index(indexes, gint, i), NULL, NULL);
+}
+
+/* rebuilds the list in model order reusing existing objects, it is used
+   when rows were reordered while inserted ones aren't added yet */
+static void fm_desktop_accessible_items_rebuild(FmDesktop *desktop)
+{
+    AtkObject *obj;
+    FmDesktopAccessiblePriv *priv;
+    FmDesktopItemAccessible *item_atk;
+    GtkTreeModel *model;
+    GtkTreeIter it;
+    GHashTable *known;
+    GList *l, *new_list = NULL;
+    GArray *added;
+    gint index = 0;
+
+    desktop->atk_pending = FALSE;
+    if (desktop->atk_added)
+        g_array_set_size(desktop->atk_added, 0);
+    if (desktop->model == NULL)
+        return;
+    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
+    if (obj == NULL || !FM_IS_DESKTOP_ACCESSIBLE(obj))
+        return;
+    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
+    known = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (l = priv->items; l; l = l->next)
+        g_hash_table_insert(known, ((FmDesktopItemAccessible *)l->data)->item, l->data);
+    added = g_array_new(FALSE, FALSE, sizeof(gint));
+    model = GTK_TREE_MODEL(desktop->model);
+    if (gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem *item = fm_folder_model_get_item_userdata(desktop->model, &it);
+
+        item_atk = g_hash_table_lookup(known, item);
+        if (item_atk == NULL)
+        {
+            item_atk = fm_desktop_item_accessible_new(desktop, item);
+            g_array_append_val(added, index);
+        }
+        new_list = g_list_prepend(new_list, item_atk);
+        index++;
+    }
+    while (gtk_tree_model_iter_next(model, &it));
+    g_hash_table_destroy(known);
+    g_list_free(priv->items);
+    priv->items = g_list_reverse(new_list);
+    fm_desktop_accessible_notify_added(obj, added);
+    g_array_free(added, TRUE);
+}
+
+/* adds accessible objects for all items inserted since last call, it is
+   done once per batch of inserted rows instead of once per row; the rows
+   are sorted by their position in the model and merged into the list in
+   one pass */
+static void fm_desktop_accessible_items_sync(FmDesktop *desktop)
+{
+    AtkObject *obj;
+    FmDesktopAccessiblePriv *priv;
+    FmDesktopItemAccessible *item_atk;
+    GtkTreeModel *model;
+    GtkTreePath *tp;
+    GArray *added, *indexes;
+    GList *l, *prev = NULL;
+    gint pos = 0;
+    guint i;
+
+    if (!desktop->atk_pending)
+        return;
+    desktop->atk_pending = FALSE;
+    if (desktop->model == NULL || desktop->atk_added == NULL ||
+        desktop->atk_added->len == 0)
+        return;
+    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
+    if (obj == NULL || !FM_IS_DESKTOP_ACCESSIBLE(obj))
+    {
+        g_array_set_size(desktop->atk_added, 0);
+        return;
+    }
+    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
+    /* rows are still in the model, deleted ones sync before removal */
+    model = GTK_TREE_MODEL(desktop->model);
+    added = g_array_sized_new(FALSE, FALSE, sizeof(FmDesktopAtkAdded),
+                              desktop->atk_added->len);
+    for (i = 0; i < desktop->atk_added->len; i++)
+    {
+        GtkTreeIter *it = &g_array_index(desktop->atk_added, GtkTreeIter, i);
+        FmDesktopAtkAdded entry;
+
+        tp = gtk_tree_model_get_path(model, it);
+        entry.index = gtk_tree_path_get_indices(tp)[0];
+        entry.item = fm_folder_model_get_item_userdata(desktop->model, it);
+        gtk_tree_path_free(tp);
+        g_array_append_val(added, entry);
+    }
+    g_array_set_size(desktop->atk_added, 0);
+    g_array_sort(added, fm_desktop_atk_added_compare);
+    indexes = g_array_sized_new(FALSE, FALSE, sizeof(gint), added->len);
+    /* list has all other rows in model order, so each item goes right
+       where its index is once all preceding ones are in place */
+    l = priv->items;
+    for (i = 0; i < added->len; i++)
+    {
+        FmDesktopAtkAdded *entry = &g_array_index(added, FmDesktopAtkAdded, i);
+
+        while (l && pos < entry->index)
+        {
+            prev = l;
+            l = l->next;
+            pos++;
+        }
+        item_atk = fm_desktop_item_accessible_new(desktop, entry->item);
+        if (l)
+        {
+            priv->items = g_list_insert_before(priv->items, l, item_atk);
+            prev = l->prev;
+        }
+        else if (prev)
+            prev = g_list_append(prev, item_atk)->next;
+        else
+            priv->items = prev = g_list_append(NULL, item_atk);
+        g_array_append_val(indexes, pos);
+        pos++;
+    }
+    g_array_free(added, TRUE);
+    fm_desktop_accessible_notify_added(obj, indexes);
+    g_array_free(indexes, TRUE);
+}
+
 static void fm_desktop_accessible_item_deleted(FmDesktop *desktop, FmDesktopItem *item)
 {
     AtkObject *obj;
@@ -1556,6 +1739,7 @@ static void fm_desktop_accessible_item_deleted(FmDesktop *desktop, FmDesktopItem
     FmDesktopItemAccessible *item_atk;
     gint index;
 
+    fm_desktop_accessible_items_sync(desktop);
     obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
@@ -1572,24 +1756,6 @@ static void fm_desktop_accessible_item_deleted(FmDesktop *desktop, FmDesktopItem
     }
 }
 
-static void fm_desktop_accessible_item_added(FmDesktop *desktop, FmDesktopItem *item,
-                                             guint index)
-{
-    AtkObject *obj;
-    FmDesktopAccessiblePriv *priv;
-    FmDesktopItemAccessible *item_atk;
-
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
-    if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
-    {
-        priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        item_atk = fm_desktop_item_accessible_new(desktop, item);
-        g_warn_if_fail(index <= g_list_length(priv->items));
-        priv->items = g_list_insert(priv->items, g_object_ref(item_atk), index);
-        g_signal_emit_by_name(obj, "children-changed::add", index, NULL, NULL);
-    }
-}
-
 static void fm_desktop_accessible_items_reordered(FmDesktop *desktop,
                                                   GtkTreeModel *model,
                                                   gint *new_order)
@@ -1599,6 +1765,12 @@ static void fm_desktop_accessible_items_reordered(FmDesktop *desktop,
     GList *new_list = NULL;
     int length, i;
 
+    if (desktop->atk_pending)
+    {
+        /* inserted rows are not in the list yet so it cannot be reordered */
+        fm_desktop_accessible_items_rebuild(desktop);
+        return;
+    }
     obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
@@ -1622,6 +1794,7 @@ static void fm_desktop_item_selected_changed(FmDesktop *desktop, FmDesktopItem *
     FmDesktopAccessiblePriv *priv;
     GList *item_atk_l;
 
+    fm_desktop_accessible_items_sync(desktop);
     obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
@@ -1633,12 +1806,23 @@ static void fm_desktop_item_selected_changed(FmDesktop *desktop, FmDesktopItem *
     }
 }
 
+/* bulk selection change, notify AT once instead of on each item */
+static void fm_desktop_accessible_selection_changed(FmDesktop *desktop)
+{
+    AtkObject *obj;
+
+    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
+    if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
+        g_signal_emit_by_name(obj, "selection-changed");
+}
+
 static void fm_desktop_accessible_focus_set(FmDesktop *desktop, FmDesktopItem *item)
 {
     AtkObject *obj;
     FmDesktopAccessiblePriv *priv;
     GList *item_atk_l;
 
+    fm_desktop_accessible_items_sync(desktop);
     obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
@@ -1655,6 +1839,7 @@ static void fm_desktop_accessible_focus_unset(FmDesktop *desktop, FmDesktopItem
     FmDesktopAccessiblePriv *priv;
     GList *item_atk_l;
 
+    fm_desktop_accessible_items_sync(desktop);
     obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
@@ -1671,6 +1856,9 @@ static void fm_desktop_accessible_model_removed(FmDesktop *desktop)
     FmDesktopAccessiblePriv *priv;
     FmDesktopItemAccessible *item_atk;
 
+    desktop->atk_pending = FALSE;
+    if (desktop->atk_added)
+        g_array_set_size(desktop->atk_added, 0);
     obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
@@ -1806,6 +1994,24 @@ static gboolean on_idle_layout(FmDesktop* desktop)
     desktop->idle_layout = 0;
     desktop->layout_pending = FALSE;
     layout_items(desktop);
+    if (desktop->batch_size > 0 && desktop->batch_timeout == 0)
+    {
+        g_debug("desktop: %u inserted items settled in %.1f ms",
+                desktop->batch_size,
+                (g_get_monotonic_time() - desktop->batch_start) / 1000.0);
+        desktop->batch_size = 0;
+    }
+    /* first layout of loaded folder is done, icons are drawn now */
+    if (desktop->startup_pending && desktop->model &&
+        fm_folder_is_loaded(fm_folder_model_get_folder(desktop->model)))
+        _startup_desktop_done(desktop);
+    if (desktop->snapshot && desktop->model &&
+        fm_folder_is_loaded(fm_folder_model_get_folder(desktop->model)))
+    {
+        /* replace items of previous session with real ones */
+        free_snapshot(desktop);
+        gtk_widget_queue_draw(GTK_WIDGET(desktop));
+    }
     return FALSE;
 }
 
@@ -1915,6 +2121,327 @@ static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRec
 #endif
 }
 
+/* ---------------------------------------------------------------------
+    Layout snapshot
+
+    The snapshot keeps names, positions and icon images of the items as
+    they were rendered in previous session. It is painted instantly on
+    startup and dropped once the desktop folder is loaded and laid out. */
+
+#define SNAPSHOT_VERSION 2
+/* version, monitor geometry, icons: width, height, rowstride, alpha,
+   pixels; items: name, icon and text rects, text origin, icon index */
+#define SNAPSHOT_TYPE "(u(iiii)a(iiibay)a(s(iiii)(iiii)(ii)i))"
+/* icons are stored once each, and no more than that many bytes of them */
+#define SNAPSHOT_ICONS_MAX_SIZE (4 * 1024 * 1024)
+
+struct _FmDesktopSnapshotItem
+{
+    char *name;
+    GdkRectangle icon_rect;
+    GdkRectangle text_rect;
+    gint text_x;
+    gint text_y;
+    GdkPixbuf *icon;
+};
+
+/* snapshot is a cache so it's kept in cache dir, per profile */
+static char* get_snapshot_file(FmDesktop* desktop, gboolean create_dir)
+{
+    char *profile_dir, *dir, *name, *path;
+    int i = get_desktop_index(desktop);
+
+    if (i < 0)
+        return NULL;
+    profile_dir = pcmanfm_get_profile_dir(FALSE);
+    name = g_path_get_basename(profile_dir);
+    dir = g_build_filename(g_get_user_cache_dir(), "pcmanfm", name, NULL);
+    g_free(name);
+    g_free(profile_dir);
+    if (create_dir)
+        g_mkdir_with_parents(dir, 0700);
+    name = g_strdup_printf("desktop-snapshot-%u", i);
+    path = g_build_filename(dir, name, NULL);
+    g_free(name);
+    g_free(dir);
+    return path;
+}
+
+static void free_snapshot(FmDesktop* desktop)
+{
+    while (desktop->snapshot)
+    {
+        FmDesktopSnapshotItem *item = desktop->snapshot->data;
+
+        g_free(item->name);
+        if (item->icon)
+            g_object_unref(item->icon);
+        g_slice_free(FmDesktopSnapshotItem, item);
+        desktop->snapshot = g_slist_delete_link(desktop->snapshot, desktop->snapshot);
+    }
+}
+
+/* adds @icon into @icons unless it's there already, returns its index
+   or -1 if there is no more room for icons */
+static gint add_snapshot_icon(GVariantBuilder *icons, GHashTable *indexes,
+                              GdkPixbuf *icon, gsize *total)
+{
+    gpointer idx;
+    gsize len;
+
+    if (g_hash_table_lookup_extended(indexes, icon, NULL, &idx))
+        return GPOINTER_TO_INT(idx);
+    len = gdk_pixbuf_get_rowstride(icon) * (gdk_pixbuf_get_height(icon) - 1)
+          + gdk_pixbuf_get_width(icon) * gdk_pixbuf_get_n_channels(icon);
+    if (*total + len > SNAPSHOT_ICONS_MAX_SIZE)
+        return -1;
+    *total += len;
+    /* pixels data are owned by icon, release it with variant */
+    g_variant_builder_add(icons, "(iiib@ay)", gdk_pixbuf_get_width(icon),
+                          gdk_pixbuf_get_height(icon),
+                          gdk_pixbuf_get_rowstride(icon),
+                          gdk_pixbuf_get_has_alpha(icon),
+                          g_variant_new_from_data(G_VARIANT_TYPE("ay"),
+                                                  gdk_pixbuf_get_pixels(icon), len,
+                                                  TRUE, g_object_unref,
+                                                  g_object_ref(icon)));
+    idx = GINT_TO_POINTER(g_hash_table_size(indexes));
+    g_hash_table_insert(indexes, icon, idx);
+    return GPOINTER_TO_INT(idx);
+}
+
+static void save_snapshot(FmDesktop* desktop)
+{
+    GtkTreeModel* model = GTK_TREE_MODEL(desktop->model);
+    GtkTreeIter it;
+    GVariantBuilder icons, items;
+    GVariant *snapshot;
+    GHashTable *indexes;
+    GdkRectangle geom;
+    gsize total = 0;
+    char *path;
+
+    path = get_snapshot_file(desktop, TRUE);
+    if (path == NULL)
+        return;
+    gdk_screen_get_monitor_geometry(gtk_widget_get_screen(GTK_WIDGET(desktop)),
+                                    desktop->monitor, &geom);
+    /* icons are shared by files of the same type */
+    indexes = g_hash_table_new(g_direct_hash, NULL);
+    g_variant_builder_init(&icons, G_VARIANT_TYPE("a(iiibay)"));
+    g_variant_builder_init(&items, G_VARIANT_TYPE("a(s(iiii)(iiii)(ii)i)"));
+    if (gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        GdkPixbuf* icon = NULL;
+        gint idx = -1;
+
+        gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
+        if (icon)
+        {
+            idx = add_snapshot_icon(&icons, indexes, icon, &total);
+            g_object_unref(icon);
+        }
+        g_variant_builder_add(&items, "(s(iiii)(iiii)(ii)i)",
+                              fm_file_info_get_disp_name(item->fi),
+                              item->icon_rect.x, item->icon_rect.y,
+                              item->icon_rect.width, item->icon_rect.height,
+                              item->text_rect.x, item->text_rect.y,
+                              item->text_rect.width, item->text_rect.height,
+                              item->area.x + (desktop->cell_w - desktop->text_w) / 2 + 2,
+                              item->text_rect.y + 2, idx);
+    }
+    while (gtk_tree_model_iter_next(model, &it));
+    g_hash_table_destroy(indexes);
+    snapshot = g_variant_ref_sink(g_variant_new(SNAPSHOT_TYPE, SNAPSHOT_VERSION,
+                                                geom.x, geom.y, geom.width,
+                                                geom.height, &icons, &items));
+    if (!g_file_set_contents(path, g_variant_get_data(snapshot),
+                             g_variant_get_size(snapshot), NULL))
+        g_warning("failed to save desktop snapshot %s", path);
+    g_variant_unref(snapshot);
+    g_free(path);
+    /* snapshot was kept in profile dir before */
+    path = get_desktop_file(desktop, FALSE, "desktop-snapshot-%u");
+    g_unlink(path);
+    g_free(path);
+}
+
+/* saves the layout to show it instantly on next start; the snapshot is
+   not replaced until the folder is loaded and laid out */
+static void save_desktop_snapshot(FmDesktop* desktop)
+{
+    if (desktop->model && desktop->snapshot == NULL && !desktop->unplugged &&
+        fm_folder_is_loaded(fm_folder_model_get_folder(desktop->model)))
+        save_snapshot(desktop);
+}
+
+static void _free_pixels(guchar *pixels, gpointer _unused)
+{
+    g_free(pixels);
+}
+
+static GdkPixbuf *load_snapshot_icon(GVariant *icon)
+{
+    GVariant *pixels;
+    const guchar *pix_data;
+    GdkPixbuf *pix = NULL;
+    gsize len;
+    gint icon_w, icon_h, rowstride, n_channels;
+    gboolean has_alpha;
+
+    g_variant_get(icon, "(iiib@ay)", &icon_w, &icon_h, &rowstride,
+                  &has_alpha, &pixels);
+    pix_data = g_variant_get_fixed_array(pixels, &len, 1);
+    n_channels = has_alpha ? 4 : 3;
+    if (icon_w > 0 && icon_h > 0 && rowstride >= icon_w * n_channels &&
+        len >= (gsize)rowstride * (icon_h - 1) + icon_w * n_channels)
+        pix = gdk_pixbuf_new_from_data(g_memdup(pix_data, len),
+                                       GDK_COLORSPACE_RGB, has_alpha, 8,
+                                       icon_w, icon_h, rowstride,
+                                       _free_pixels, NULL);
+    g_variant_unref(pixels);
+    return pix;
+}
+
+static void load_snapshot(FmDesktop* desktop)
+{
+    GVariant *snapshot, *icons_v, *icon;
+    GVariantIter *items;
+    GdkRectangle geom;
+    FmDesktopSnapshotItem *item;
+    GdkPixbuf **icons = NULL;
+    char *path, *data;
+    gsize len, n_icons = 0, i;
+    guint version;
+    gint x, y, w, h, idx;
+
+    free_snapshot(desktop);
+    path = get_snapshot_file(desktop, FALSE);
+    if (path == NULL)
+        return;
+    if (!g_file_get_contents(path, &data, &len, NULL))
+    {
+        g_free(path);
+        return;
+    }
+    g_free(path);
+    /* GVariant is safe against corrupted data so no validation is needed */
+    snapshot = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(SNAPSHOT_TYPE),
+                                                          data, len, FALSE,
+                                                          g_free, data));
+    g_variant_get(snapshot, SNAPSHOT_TYPE, &version, &x, &y, &w, &h,
+                  NULL, &items);
+    gdk_screen_get_monitor_geometry(gtk_widget_get_screen(GTK_WIDGET(desktop)),
+                                    desktop->monitor, &geom);
+    /* positions are useless if monitor was changed since last session */
+    if (version == SNAPSHOT_VERSION && x == geom.x && y == geom.y &&
+        w == geom.width && h == geom.height)
+    {
+        icons_v = g_variant_get_child_value(snapshot, 2);
+        n_icons = g_variant_n_children(icons_v);
+        icons = g_new0(GdkPixbuf*, n_icons);
+        for (i = 0; i < n_icons; i++)
+        {
+            icon = g_variant_get_child_value(icons_v, i);
+            icons[i] = load_snapshot_icon(icon);
+            g_variant_unref(icon);
+        }
+        g_variant_unref(icons_v);
+        item = g_slice_new0(FmDesktopSnapshotItem);
+        while (g_variant_iter_next(items, "(s(iiii)(iiii)(ii)i)",
+                                   &item->name,
+                                   &item->icon_rect.x, &item->icon_rect.y,
+                                   &item->icon_rect.width, &item->icon_rect.height,
+                                   &item->text_rect.x, &item->text_rect.y,
+                                   &item->text_rect.width, &item->text_rect.height,
+                                   &item->text_x, &item->text_y, &idx))
+        {
+            if (idx >= 0 && (gsize)idx < n_icons && icons[idx])
+                item->icon = g_object_ref(icons[idx]);
+            desktop->snapshot = g_slist_prepend(desktop->snapshot, item);
+            item = g_slice_new0(FmDesktopSnapshotItem);
+        }
+        g_slice_free(FmDesktopSnapshotItem, item);
+        desktop->snapshot = g_slist_reverse(desktop->snapshot);
+        for (i = 0; i < n_icons; i++)
+            if (icons[i])
+                g_object_unref(icons[i]);
+        g_free(icons);
+    }
+    g_variant_iter_free(items);
+    g_variant_unref(snapshot);
+    g_debug("loaded %u items from desktop snapshot", g_slist_length(desktop->snapshot));
+}
+
+/**
+ * fm_desktop_manager_save_snapshots
+ *
+ * Saves layout of each desktop to show it instantly on next start. Should
+ * be called when application exits since desktops are not destroyed then.
+ */
+void fm_desktop_manager_save_snapshots(void)
+{
+    int i;
+
+    for (i = 0; i < n_screens; i++)
+        save_desktop_snapshot(desktops[i]);
+}
+
+/* folder cannot be loaded so its snapshot should not be shown anymore */
+static void drop_snapshot(FmDesktop* desktop)
+{
+    char *path;
+
+    if (desktop->snapshot == NULL)
+        return;
+    free_snapshot(desktop);
+    path = get_snapshot_file(desktop, FALSE);
+    if (path)
+    {
+        g_unlink(path);
+        g_free(path);
+    }
+    gtk_widget_queue_draw(GTK_WIDGET(desktop));
+}
+
+static void paint_snapshot(FmDesktop* self, cairo_t* cr, GdkRectangle* area)
+{
+    GSList *l;
+    GdkRectangle tmp;
+
+    for (l = self->snapshot; l; l = l->next)
+    {
+        FmDesktopSnapshotItem *item = l->data;
+
+        if (gdk_rectangle_intersect(area, &item->text_rect, &tmp))
+        {
+            pango_layout_set_text(self->pl, NULL, 0);
+            pango_layout_set_width(self->pl, self->pango_text_w);
+            pango_layout_set_height(self->pl, self->pango_text_h);
+            pango_layout_set_text(self->pl, item->name, -1);
+            /* the shadow */
+            gdk_cairo_set_source_color(cr, &self->conf.desktop_shadow);
+            cairo_move_to(cr, item->text_x + 1, item->text_y + 1);
+            pango_cairo_show_layout(cr, self->pl);
+            /* real text */
+            gdk_cairo_set_source_color(cr, &self->conf.desktop_fg);
+            cairo_move_to(cr, item->text_x, item->text_y);
+            pango_cairo_show_layout(cr, self->pl);
+            pango_layout_set_text(self->pl, NULL, 0);
+        }
+        if (item->icon && gdk_rectangle_intersect(area, &item->icon_rect, &tmp))
+        {
+            /* the icon is centered in the rectangle, see paint_item() */
+            gdk_cairo_set_source_pixbuf(cr, item->icon,
+                    item->icon_rect.x + (item->icon_rect.width - gdk_pixbuf_get_width(item->icon)) / 2,
+                    item->icon_rect.y + (item->icon_rect.height - gdk_pixbuf_get_height(item->icon)) / 2);
+            gdk_cairo_rectangle(cr, &tmp);
+            cairo_fill(cr);
+        }
+    }
+}
+
 static void redraw_item(FmDesktop* desktop, FmDesktopItem* item)
 {
     GdkRectangle rect;
@@ -2041,7 +2568,7 @@ static void update_rubberbanding(FmDesktop* self, int newx, int newy)
         if ((item->is_rubber_banded && !selected) ||
             (!item->is_rubber_banded && selected))
         {
-            item->is_selected = selected;
+            set_item_selected(self, item, selected);
             redraw_item(self, item);
             fm_desktop_item_selected_changed(self, item);
         }
@@ -2115,28 +2642,100 @@ static void _clear_bg_cache(FmDesktop *self)
     }
 }
 
-static void update_background(FmDesktop* desktop, int is_it)
+static void set_solid_background(FmDesktop* desktop)
 {
-    GtkWidget* widget = (GtkWidget*)desktop;
-    GdkPixbuf* pix, *scaled;
-    cairo_t* cr;
-    GdkScreen *screen = gtk_widget_get_screen(widget);
-    GdkWindow* root = gdk_screen_get_root_window(screen);
-    GdkWindow *window = gtk_widget_get_window(widget);
-    FmBackgroundCache *cache;
+    GdkWindow *window = gtk_widget_get_window(GTK_WIDGET(desktop));
 #if GTK_CHECK_VERSION(3, 0, 0)
     cairo_pattern_t *pattern;
-#endif
 
-    Display* xdisplay;
-    Pixmap xpixmap;
-    Window xroot;
-    int screen_num = gdk_screen_get_number(screen);
+    pattern = cairo_pattern_create_rgb(desktop->conf.desktop_bg.red / 65535.0,
+                                       desktop->conf.desktop_bg.green / 65535.0,
+                                       desktop->conf.desktop_bg.blue / 65535.0);
+    gdk_window_set_background_pattern(window, pattern);
+    cairo_pattern_destroy(pattern);
+#else
+    GdkColor bg = desktop->conf.desktop_bg;
 
-    char *wallpaper;
+    gdk_colormap_alloc_color(gdk_drawable_get_colormap(window), &bg, FALSE, TRUE);
+    gdk_window_set_back_pixmap(window, NULL, FALSE);
+    gdk_window_set_background(window, &bg);
+#endif
+    gdk_window_invalidate_rect(window, NULL, TRUE);
+}
 
-    if (!desktop->conf.wallpaper_common)
-    {
+/* returns wallpaper file which should be shown on current desktop on refresh */
+static const char *get_current_wallpaper(FmDesktop* desktop)
+{
+    const char *wallpaper = NULL;
+
+    if (desktop->conf.wallpaper_mode == FM_WP_COLOR)
+        return NULL;
+    if (!desktop->conf.wallpaper_common &&
+        (gint)desktop->cur_desktop < desktop->conf.wallpapers_configured)
+        wallpaper = desktop->conf.wallpapers[desktop->cur_desktop];
+    if (wallpaper == NULL)
+        wallpaper = desktop->conf.wallpaper;
+    if (wallpaper == NULL || wallpaper[0] == '\0')
+        return NULL;
+    return wallpaper;
+}
+
+static void _clear_preloaded_wallpaper(FmDesktop* desktop)
+{
+    if (desktop->preloaded_pix)
+        g_object_unref(desktop->preloaded_pix);
+    desktop->preloaded_pix = NULL;
+    g_free(desktop->preloaded_file);
+    desktop->preloaded_file = NULL;
+}
+
+static GdkPixbuf *load_wallpaper(FmDesktop* desktop, const char *wallpaper)
+{
+    GdkPixbuf *pix;
+
+    /* use the image decoded in background on startup if it is still actual */
+    if (desktop->preloaded_pix && g_strcmp0(desktop->preloaded_file, wallpaper) == 0)
+        pix = g_object_ref(desktop->preloaded_pix);
+    else
+        pix = gdk_pixbuf_new_from_file(wallpaper, NULL);
+    _clear_preloaded_wallpaper(desktop);
+    return pix;
+}
+
+static void update_background(FmDesktop* desktop, int is_it)
+{
+    GtkWidget* widget = (GtkWidget*)desktop;
+    GdkPixbuf* pix, *scaled;
+    cairo_t* cr;
+    GdkScreen *screen = gtk_widget_get_screen(widget);
+    GdkWindow* root = gdk_screen_get_root_window(screen);
+    GdkWindow *window = gtk_widget_get_window(widget);
+    FmBackgroundCache *cache;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_pattern_t *pattern;
+#endif
+
+    Display* xdisplay;
+    Pixmap xpixmap;
+    Window xroot;
+    int screen_num = gdk_screen_get_number(screen);
+
+    char *wallpaper;
+
+    /* monitor is gone, background will be updated when it's back */
+    if (desktop->unplugged)
+        return;
+
+    if (is_it < 0 && desktop->wallpaper_pending)
+    {
+        /* startup is in progress and wallpaper is being decoded yet, see
+           _startup_decode_wallpapers(), so show solid color meanwhile */
+        set_solid_background(desktop);
+        return;
+    }
+
+    if (!desktop->conf.wallpaper_common)
+    {
         guint32 cur_desktop = desktop->cur_desktop;
 
         if(is_it >= 0) /* signal "changed::wallpaper" */
@@ -2226,7 +2825,7 @@ static void update_background(FmDesktop* desktop, int is_it)
         if(cache && cache->wallpaper_mode == desktop->conf.wallpaper_mode
            && st.st_mtime == cache->mtime)
             pix = NULL; /* no new pix for it */
-        else if((pix = gdk_pixbuf_new_from_file(wallpaper, NULL)))
+        else if((pix = load_wallpaper(desktop, wallpaper)))
         {
             if(cache)
             {
@@ -2257,20 +2856,7 @@ static void update_background(FmDesktop* desktop, int is_it)
 
     if(!cache) /* solid color only */
     {
-#if GTK_CHECK_VERSION(3, 0, 0)
-        pattern = cairo_pattern_create_rgb(desktop->conf.desktop_bg.red / 65535.0,
-                                           desktop->conf.desktop_bg.green / 65535.0,
-                                           desktop->conf.desktop_bg.blue / 65535.0);
-        gdk_window_set_background_pattern(window, pattern);
-        cairo_pattern_destroy(pattern);
-#else
-        GdkColor bg = desktop->conf.desktop_bg;
-
-        gdk_colormap_alloc_color(gdk_drawable_get_colormap(window), &bg, FALSE, TRUE);
-        gdk_window_set_back_pixmap(window, NULL, FALSE);
-        gdk_window_set_background(window, &bg);
-#endif
-        gdk_window_invalidate_rect(window, NULL, TRUE);
+        set_solid_background(desktop);
         return;
     }
 
@@ -2467,6 +3053,7 @@ static void on_row_deleting(FmFolderModel* model, GtkTreePath* tp,
         if (desktop->focus)
             fm_desktop_accessible_focus_set(desktop, desktop->focus);
     }
+    set_item_selected(desktop, data, FALSE);
     if((gpointer)desktop->drop_hilight == data)
         desktop->drop_hilight = NULL;
     if((gpointer)desktop->hover_item == data)
@@ -2479,13 +3066,35 @@ static void on_row_deleting(FmFolderModel* model, GtkTreePath* tp,
     desktop_item_free(data);
 }
 
+static gboolean on_batch_timeout(gpointer user_data)
+{
+    FmDesktop* desktop;
+
+    if(g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    desktop = user_data;
+    desktop->batch_timeout = 0;
+    fm_desktop_accessible_items_sync(desktop);
+    queue_layout_items(desktop);
+    return FALSE;
+}
+
 static void on_row_inserted(FmFolderModel* mod, GtkTreePath* tp, GtkTreeIter* it, FmDesktop* desktop)
 {
     FmDesktopItem* item = desktop_item_new(mod, it);
-    gint *indices = gtk_tree_path_get_indices(tp);
-    fm_desktop_accessible_item_added(desktop, item, indices[0]);
     fm_folder_model_set_item_userdata(mod, it, item);
-    queue_layout_items(desktop);
+    /* accessibility update, layout and redraw are done once per batch of
+       rows inserted within one frame, see on_batch_timeout() */
+    desktop->atk_pending = TRUE;
+    if (desktop->atk_added == NULL)
+        desktop->atk_added = g_array_new(FALSE, FALSE, sizeof(GtkTreeIter));
+    g_array_append_val(desktop->atk_added, *it);
+    if (desktop->batch_size++ == 0)
+        desktop->batch_start = g_get_monotonic_time();
+    if (desktop->batch_timeout == 0)
+        desktop->batch_timeout = gdk_threads_add_timeout(BATCH_FRAME_TIME,
+                                                         on_batch_timeout,
+                                                         desktop);
 }
 
 static void on_row_deleted(FmFolderModel* mod, GtkTreePath* tp, FmDesktop* desktop)
@@ -2523,10 +3132,33 @@ static void on_rows_reordered(FmFolderModel* model, GtkTreePath* parent_tp, GtkT
 /* ---------------------------------------------------------------------
     Events handlers */
 
-static void update_working_area(FmDesktop* desktop)
+#if !GTK_CHECK_VERSION(3, 4, 0)
+static gint get_n_desktops_for_root_window(GdkWindow *root)
+{
+    gint n_desktops = -1;
+    Atom ret_type;
+    gulong len, after;
+    int format;
+    guchar* prop;
+
+    if(XGetWindowProperty(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root),
+                          XA_NET_NUMBER_OF_DESKTOPS, 0, 1, False, XA_CARDINAL, &ret_type,
+                          &format, &len, &after, &prop) == Success &&
+       prop != NULL)
+    {
+        n_desktops = (gint)*(guint32*)prop;
+        XFree(prop);
+    }
+    return n_desktops;
+}
+#endif
+
+/* returns TRUE if working area was changed */
+static gboolean update_working_area(FmDesktop* desktop)
 {
     GdkScreen* screen = gtk_widget_get_screen((GtkWidget*)desktop);
     GdkRectangle geom;
+    GdkRectangle old_area = desktop->working_area;
 #if GTK_CHECK_VERSION(3, 4, 0)
     gdk_screen_get_monitor_workarea(screen, desktop->monitor, &desktop->working_area);
     /* we need working area coordinates within the monitor not the screen */
@@ -2539,43 +3171,33 @@ static void update_working_area(FmDesktop* desktop)
     gulong len, after;
     int format;
     guchar* prop;
-    guint32 n_desktops, cur_desktop;
     gulong* working_area;
 
     /* default to screen size */
     gdk_screen_get_monitor_geometry(screen, desktop->monitor, &geom);
+    desktop->working_area.x = 0;
+    desktop->working_area.y = 0;
     desktop->working_area.width = geom.width;
     desktop->working_area.height = geom.height;
 
-    if(XGetWindowProperty(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root),
-                       XA_NET_NUMBER_OF_DESKTOPS, 0, 1, False, XA_CARDINAL, &ret_type,
-                       &format, &len, &after, &prop) != Success)
-        goto _out;
-    if(!prop)
+    /* number of desktops and current desktop are cached and updated by
+       on_root_event() so only _NET_WORKAREA itself should be read here */
+    if(desktop->n_desktops < 0)
+        desktop->n_desktops = get_n_desktops_for_root_window(root);
+    if(desktop->n_desktops <= 0 || desktop->cur_desktop >= (guint)desktop->n_desktops)
         goto _out;
-    n_desktops = *(guint32*)prop;
-    XFree(prop);
-
-    if(XGetWindowProperty(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root),
-                       XA_NET_CURRENT_DESKTOP, 0, 1, False, XA_CARDINAL, &ret_type,
-                       &format, &len, &after, &prop) != Success)
-        goto _out;
-    if(!prop)
-        goto _out;
-    cur_desktop = *(guint32*)prop;
-    XFree(prop);
 
     if(XGetWindowProperty(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root),
                        XA_NET_WORKAREA, 0, 4 * 32, False, AnyPropertyType, &ret_type,
                        &format, &len, &after, &prop) != Success)
         goto _out;
-    if(ret_type == None || format == 0 || len != n_desktops*4)
+    if(ret_type == None || format == 0 || len != (gulong)desktop->n_desktops*4)
     {
         if(prop)
             XFree(prop);
         goto _out;
     }
-    working_area = ((gulong*)prop) + cur_desktop * 4;
+    working_area = ((gulong*)prop) + desktop->cur_desktop * 4;
 
     desktop->working_area.x = (gint)working_area[0] - geom.x;
     desktop->working_area.y = (gint)working_area[1] - geom.y;
@@ -2598,53 +3220,163 @@ static void update_working_area(FmDesktop* desktop)
     XFree(prop);
 _out:
 #endif
-    queue_layout_items(desktop);
-    return;
+    return (old_area.x != desktop->working_area.x ||
+            old_area.y != desktop->working_area.y ||
+            old_area.width != desktop->working_area.width ||
+            old_area.height != desktop->working_area.height);
+}
+
+static gboolean on_working_area_timeout(gpointer user_data)
+{
+    FmDesktop* self;
+
+    if(g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    self = user_data;
+    self->workarea_timeout = 0;
+    if(self->unplugged)
+        return FALSE;
+    /* relayout (and redraw) only if it's really changed */
+    if(update_working_area(self))
+        queue_layout_items(self);
+    return FALSE;
+}
+
+/* root events may come in bursts, handle them once per frame */
+static void queue_update_working_area(FmDesktop* self)
+{
+    if(self->workarea_timeout == 0)
+        self->workarea_timeout = gdk_threads_add_timeout(BATCH_FRAME_TIME,
+                                                         on_working_area_timeout,
+                                                         self);
 }
 
 static GdkFilterReturn on_root_event(GdkXEvent *xevent, GdkEvent *event, gpointer data)
 {
     XPropertyEvent * evt = (XPropertyEvent*) xevent;
     FmDesktop* self = (FmDesktop*)data;
+    if (self->unplugged) /* will be updated when monitor is back */
+        return GDK_FILTER_CONTINUE;
     if (evt->type == PropertyNotify)
     {
         if(evt->atom == XA_NET_WORKAREA)
-            update_working_area(self);
+            queue_update_working_area(self);
         else if(evt->atom == XA_NET_CURRENT_DESKTOP)
         {
             gint desktop = get_desktop_for_root_window(gdk_screen_get_root_window(
                                     gtk_widget_get_screen(GTK_WIDGET(data))));
-            if(desktop >= 0)
+            if(desktop >= 0 && (guint)desktop != self->cur_desktop)
             {
                 self->cur_desktop = (guint)desktop;
                 if(!self->conf.wallpaper_common)
                     update_background(self, -1);
+#if !GTK_CHECK_VERSION(3, 4, 0)
+                /* working area is taken for current desktop */
+                queue_update_working_area(self);
+#endif
             }
         }
+#if !GTK_CHECK_VERSION(3, 4, 0)
+        else if(evt->atom == XA_NET_NUMBER_OF_DESKTOPS)
+        {
+            self->n_desktops = -1; /* invalidate cached value */
+            queue_update_working_area(self);
+        }
+#endif
     }
     return GDK_FILTER_CONTINUE;
 }
 
-static void on_screen_size_changed(GdkScreen* screen, FmDesktop* desktop)
+static void _desktop_populate(FmDesktop *desktop);
+
+/* monitor was connected again: reuse the desktop with all its state */
+static void plug_desktop(FmDesktop* desktop, GdkScreen* screen)
 {
     GdkRectangle geom;
-    if (desktop->monitor >= gdk_screen_get_n_monitors(screen))
-    {
-        gint i;
-        /* our monitor was disconnected... remove FmDesktop now! */
-        for (i = 0; i < n_screens; i++)
-            if (desktops[i] == desktop)
-                break;
-        if (i < n_screens)
-            desktops[i] = fm_desktop_new(screen, desktop->monitor ? -2 : -1);
-        gtk_widget_destroy(GTK_WIDGET(desktop));
-        return;
-    }
+
+    gboolean was_unplugged = desktop->unplugged;
+
     gdk_screen_get_monitor_geometry(screen, desktop->monitor, &geom);
     gtk_window_resize((GtkWindow*)desktop, geom.width, geom.height);
     /* bug #3614780: if monitor was moved desktop should be moved too */
     gtk_window_move((GtkWindow*)desktop, geom.x, geom.y);
-    /* FIXME: check if new monitor was added! */
+    if (was_unplugged)
+    {
+        gint n;
+
+        desktop->unplugged = FALSE;
+        /* root events were ignored while monitor was away */
+        n = get_desktop_for_root_window(gdk_screen_get_root_window(screen));
+        if (n >= 0)
+            desktop->cur_desktop = (guint)n;
+        desktop->n_desktops = -1;
+        gtk_widget_show(GTK_WIDGET(desktop));
+        gdk_window_lower(gtk_widget_get_window(GTK_WIDGET(desktop)));
+    }
+    /* if size is the same then on_size_allocate() will not be called but
+       position of the monitor and its working area still might be changed;
+       wallpaper also might be changed while monitor was away */
+    if ((was_unplugged || desktop->conf.wallpaper_mode == FM_WP_SCREEN) &&
+        gtk_widget_get_realized(GTK_WIDGET(desktop)))
+    {
+        _clear_bg_cache(desktop);
+        update_background(desktop, -1);
+    }
+    queue_update_working_area(desktop);
+}
+
+/* monitor was disconnected: keep the desktop hidden until it's back */
+static void unplug_desktop(FmDesktop* desktop)
+{
+    if (desktop->unplugged)
+        return;
+    desktop->unplugged = TRUE;
+    gtk_widget_hide(GTK_WIDGET(desktop));
+}
+
+static void on_monitors_changed(GdkScreen* screen, gpointer _unused)
+{
+    gint n_mon = gdk_screen_get_n_monitors(screen);
+    gint i, n = 0;
+
+    /* desktops of the screen have monitors numbered in order of creation */
+    for (i = 0; i < n_screens; i++)
+    {
+        if (gtk_widget_get_screen(GTK_WIDGET(desktops[i])) != screen)
+            continue;
+        if (desktops[i]->monitor < 0)
+            return; /* screen isn't managed */
+        n++;
+        if (desktops[i]->monitor < n_mon)
+            plug_desktop(desktops[i], screen);
+        else
+            unplug_desktop(desktops[i]);
+    }
+    /* add desktops for monitors that were never seen before; they are
+       appended since index of desktop is used in names of its files */
+    if (n == 0 || n >= n_mon)
+        return;
+    desktops = g_renew(FmDesktop*, desktops, n_screens + n_mon - n);
+    for (; n < n_mon; n++)
+    {
+        FmDesktop *desktop = fm_desktop_new(screen, n);
+        GtkWidget *widget = GTK_WIDGET(desktop);
+
+        desktops[n_screens++] = desktop;
+        gtk_widget_realize(widget);
+        if (desktop->wallpaper_pending)
+        {
+            /* startup is in progress but there is no job for it */
+            desktop->wallpaper_pending = FALSE;
+            update_background(desktop, -1);
+        }
+        gtk_widget_show_all(widget);
+        gdk_window_lower(gtk_widget_get_window(widget));
+        /* if wallpapers are being decoded yet then icons will be populated
+           after that for all desktops, see _startup_populate_icons() */
+        if (startup_wallpapers == 0)
+            _desktop_populate(desktop);
+    }
 }
 
 static void reload_icons()
@@ -3098,7 +3830,7 @@ static void set_focused_item(FmDesktop* desktop, FmDesktopItem* item)
 
 static void _focus_and_select_focused_item(FmDesktop *desktop, FmDesktopItem *item)
 {
-    item->is_selected = TRUE;
+    set_item_selected(desktop, item, TRUE);
     fm_desktop_item_selected_changed(desktop, item);
     set_focused_item(desktop, item);
 }
@@ -3207,7 +3939,10 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
     if(self->rubber_bending)
         paint_rubber_banding_rect(self, cr, &area);
 
-    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    /* items from previous session are shown until folder is laid out */
+    if(self->snapshot)
+        paint_snapshot(self, cr, &area);
+    else if(model && gtk_tree_model_get_iter_first(model, &it)) do
     {
         FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
         GdkRectangle* intersect, tmp, tmp2;
@@ -3246,6 +3981,7 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
 static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
 {
     FmDesktop* self = (FmDesktop*)w;
+    GtkAllocation old_alloc;
 
     /* calculate item size */
     PangoContext* pc;
@@ -3278,8 +4014,9 @@ static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
     self->cell_h = fm_config->big_icon_size + self->spacing + self->text_h + self->ypad * 2;
     self->cell_w = MAX((gint)self->text_w, fm_config->big_icon_size) + self->xpad * 2;
 
+    /* cell size might be changed so relayout is needed anyway */
     update_working_area(self);
-    /* queue_layout_items(self); this is called in update_working_area */
+    queue_layout_items(self);
 
     /* scale the wallpaper */
     if(gtk_widget_get_realized(w))
@@ -3292,40 +4029,50 @@ static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
         pango_font_description_free(font_desc);
 #endif
         /* bug #3614866: after monitor geometry was changed we need to redraw
-           the background invalidating all the cache */
-        _clear_bg_cache(self);
-        if(self->conf.wallpaper_mode != FM_WP_COLOR && self->conf.wallpaper_mode != FM_WP_TILE)
-            update_background(self, -1);
+           the background invalidating all the cache; keep the cache if
+           size is still the same, e.g. the same monitor was plugged back */
+        gtk_widget_get_allocation(w, &old_alloc);
+        if(old_alloc.width != alloc->width || old_alloc.height != alloc->height
+           || self->conf.wallpaper_mode == FM_WP_SCREEN)
+        {
+            _clear_bg_cache(self);
+            if(self->conf.wallpaper_mode != FM_WP_COLOR && self->conf.wallpaper_mode != FM_WP_TILE)
+                update_background(self, -1);
+        }
     }
 
     GTK_WIDGET_CLASS(fm_desktop_parent_class)->size_allocate(w, alloc);
 }
 
+/* size of the monitor, or the last size if the monitor is unplugged */
+static void get_monitor_size(GtkWidget *w, GdkRectangle *geom)
+{
+    if (FM_DESKTOP(w)->unplugged)
+        gtk_widget_get_allocation(w, geom);
+    else
+        gdk_screen_get_monitor_geometry(gtk_widget_get_screen(w),
+                                        FM_DESKTOP(w)->monitor, geom);
+}
+
 #if GTK_CHECK_VERSION(3, 0, 0)
 static void on_get_preferred_width(GtkWidget *w, gint *minimal_width, gint *natural_width)
 {
-    GdkScreen* scr = gtk_widget_get_screen(w);
-    gint monitor = FM_DESKTOP(w)->monitor;
     GdkRectangle geom;
-    gdk_screen_get_monitor_geometry(scr, monitor, &geom);
+    get_monitor_size(w, &geom);
     *minimal_width = *natural_width = geom.width;
 }
 
 static void on_get_preferred_height(GtkWidget *w, gint *minimal_height, gint *natural_height)
 {
-    GdkScreen* scr = gtk_widget_get_screen(w);
-    gint monitor = FM_DESKTOP(w)->monitor;
     GdkRectangle geom;
-    gdk_screen_get_monitor_geometry(scr, monitor, &geom);
+    get_monitor_size(w, &geom);
     *minimal_height = *natural_height = geom.height;
 }
 #else
 static void on_size_request(GtkWidget* w, GtkRequisition* req)
 {
-    GdkScreen* scr = gtk_widget_get_screen(w);
-    gint monitor = FM_DESKTOP(w)->monitor;
     GdkRectangle geom;
-    gdk_screen_get_monitor_geometry(scr, monitor, &geom);
+    get_monitor_size(w, &geom);
     req->width = geom.width;
     req->height = geom.height;
 }
@@ -3399,9 +4146,9 @@ static gboolean on_button_press(GtkWidget* w, GdkEventButton* evt)
         if(clicked_item)
         {
             if(evt->state & (GDK_SHIFT_MASK | GDK_CONTROL_MASK))
-                clicked_item->is_selected = ! clicked_item->is_selected;
+                set_item_selected(self, clicked_item, !clicked_item->is_selected);
             else
-                clicked_item->is_selected = TRUE;
+                set_item_selected(self, clicked_item, TRUE);
             fm_desktop_item_selected_changed(self, clicked_item);
 
             if(self->focus && self->focus != item)
@@ -3549,11 +4296,11 @@ static gboolean on_single_click_timeout(gpointer user_data)
     if (state == 0) /* no modifiers - drop selection and select this item */
     {
         _unselect_all(FM_FOLDER_VIEW(self));
-        item->is_selected = TRUE;
+        set_item_selected(self, item, TRUE);
     }
     else if (state == GDK_CONTROL_MASK) /* invert selection on the item */
     {
-        item->is_selected = ! item->is_selected;
+        set_item_selected(self, item, !item->is_selected);
     }
     else /* ignore other modifiers */
         return FALSE;
@@ -3918,6 +4665,9 @@ static void desktop_search_position(FmDesktop *desktop)
     GdkRectangle geom;
     gint x, y;
 
+    if (desktop->unplugged)
+        return;
+
     /* make sure the search dialog is realized */
     gtk_widget_realize(desktop->search_window);
 
@@ -4112,7 +4862,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
             if(0 == modifier)
             {
                 _unselect_all(FM_FOLDER_VIEW(desktop));
-                item->is_selected = TRUE;
+                set_item_selected(desktop, item, TRUE);
                 fm_desktop_item_selected_changed(desktop, item);
             }
             set_focused_item(desktop, item);
@@ -4125,7 +4875,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
             if(0 == modifier)
             {
                 _unselect_all(FM_FOLDER_VIEW(desktop));
-                item->is_selected = TRUE;
+                set_item_selected(desktop, item, TRUE);
                 fm_desktop_item_selected_changed(desktop, item);
             }
             set_focused_item(desktop, item);
@@ -4138,7 +4888,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
             if(0 == modifier)
             {
                 _unselect_all(FM_FOLDER_VIEW(desktop));
-                item->is_selected = TRUE;
+                set_item_selected(desktop, item, TRUE);
                 fm_desktop_item_selected_changed(desktop, item);
             }
             set_focused_item(desktop, item);
@@ -4151,7 +4901,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
             if(0 == modifier)
             {
                 _unselect_all(FM_FOLDER_VIEW(desktop));
-                item->is_selected = TRUE;
+                set_item_selected(desktop, item, TRUE);
                 fm_desktop_item_selected_changed(desktop, item);
             }
             set_focused_item(desktop, item);
@@ -4162,7 +4912,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
         {
             if(desktop->focus)
             {
-                desktop->focus->is_selected = !desktop->focus->is_selected;
+                set_item_selected(desktop, desktop->focus, !desktop->focus->is_selected);
                 redraw_item(desktop, desktop->focus);
                 fm_desktop_item_selected_changed(desktop, desktop->focus);
             }
@@ -4305,7 +5055,13 @@ static void on_realize(GtkWidget* w)
     /* copy found configuration to use by next monitor */
     else if (!app_config->desktop_section.configured)
         copy_desktop_config(&app_config->desktop_section, &self->conf);
+    /* on startup the wallpaper will be decoded later in background */
+    if (startup_time != 0 && get_current_wallpaper(self) != NULL)
+        self->wallpaper_pending = TRUE;
     update_background(self, -1);
+    /* show items from previous session until the folder is loaded */
+    if (startup_time != 0)
+        load_snapshot(self);
     /* set a proper desktop font if needed */
     if (self->conf.desktop_font == NULL)
         self->conf.desktop_font = g_strdup("Sans 12");
@@ -4680,6 +5436,12 @@ static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErro
                 return FM_JOB_RETRY;
         }
     }
+    /* folder will not be loaded, don't wait for it on startup */
+    if(severity >= FM_JOB_ERROR_SEVERE)
+    {
+        _startup_desktop_done(user_data);
+        drop_snapshot(user_data);
+    }
     fm_show_error(NULL, NULL, err->message);
     return FM_JOB_CONTINUE;
 }
@@ -4801,6 +5563,7 @@ static inline void disconnect_model(FmDesktop* desktop)
 #endif
     g_object_unref(desktop->model);
     desktop->model = NULL;
+    g_queue_clear(&desktop->selected);
     fm_desktop_accessible_model_removed(desktop);
     /* update popup now */
     fm_folder_view_add_popup(FM_FOLDER_VIEW(desktop), GTK_WINDOW(desktop),
@@ -4839,15 +5602,20 @@ static void fm_desktop_destroy(GtkObject *object)
         screen = gtk_widget_get_screen((GtkWidget*)self);
         gdk_window_remove_filter(gdk_screen_get_root_window(screen), on_root_event, self);
 
-        g_signal_handlers_disconnect_by_func(screen, on_screen_size_changed, self);
 #if FM_CHECK_VERSION(1, 2, 0)
         g_signal_handlers_disconnect_by_func(app_config, on_show_full_names_changed, self);
 #endif
 
         gtk_window_group_remove_window(win_group, (GtkWindow*)self);
 
+        _startup_desktop_done(self);
+
         if (self->model)
+        {
+            save_desktop_snapshot(self);
             disconnect_model(self);
+        }
+        free_snapshot(self);
 
         unload_items(self);
 
@@ -4861,6 +5629,18 @@ static void fm_desktop_destroy(GtkObject *object)
         if(self->idle_layout)
             g_source_remove(self->idle_layout);
 
+        if(self->batch_timeout)
+            g_source_remove(self->batch_timeout);
+
+        if(self->atk_added)
+        {
+            g_array_free(self->atk_added, TRUE);
+            self->atk_added = NULL;
+        }
+
+        if(self->workarea_timeout)
+            g_source_remove(self->workarea_timeout);
+
         g_signal_handlers_disconnect_by_func(self->dnd_src, on_dnd_src_data_get, self);
         g_object_unref(self->dnd_src);
         g_object_unref(self->dnd_dest);
@@ -4884,6 +5664,7 @@ static void fm_desktop_destroy(GtkObject *object)
     }
 
     _clear_bg_cache(self);
+    _clear_preloaded_wallpaper(self);
 
     /* cancel any pending search timeout */
     if (G_UNLIKELY(self->search_timeout_id))
@@ -4980,12 +5761,12 @@ static GObject* fm_desktop_constructor(GType type, guint n_construct_properties,
     root = gdk_screen_get_root_window(screen);
     gdk_window_set_events(root, gdk_window_get_events(root)|GDK_PROPERTY_CHANGE_MASK);
     gdk_window_add_filter(root, on_root_event, self);
-    g_signal_connect(screen, "monitors-changed", G_CALLBACK(on_screen_size_changed), self);
 
     n = get_desktop_for_root_window(root);
     if(n < 0)
         n = 0;
     self->cur_desktop = (guint)n;
+    self->n_desktops = -1; /* will be read on first use */
 
     /* init dnd support */
     self->dnd_src = fm_dnd_src_new((GtkWidget*)self);
@@ -5180,83 +5961,62 @@ static FmFolderModel* _get_model(FmFolderView* fv)
 
 static gint _count_selected_files(FmFolderView* fv)
 {
-    FmDesktop* desktop = FM_DESKTOP(fv);
-    GtkTreeModel* model;
-    GtkTreeIter it;
-    gint n = 0;
-
-    if (!desktop->model)
-        return 0;
-    model = GTK_TREE_MODEL(desktop->model);
-    if(!gtk_tree_model_get_iter_first(model, &it))
-        return 0;
-    do
-    {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if(item->is_selected)
-            n++;
-    }
-    while(gtk_tree_model_iter_next(model, &it));
-    return n;
+    return FM_DESKTOP(fv)->selected.length;
 }
 
 static FmFileInfoList* _dup_selected_files(FmFolderView* fv)
 {
     FmDesktop* desktop = FM_DESKTOP(fv);
-    FmFileInfoList* files = NULL;
-    GtkTreeModel* model;
-    GtkTreeIter it;
+    FmFileInfoList* files;
+    GList* l;
 
-    if (!desktop->model)
-        return NULL;
-    model = GTK_TREE_MODEL(desktop->model);
-    if(!gtk_tree_model_get_iter_first(model, &it))
+    if (desktop->selected.length == 0)
         return NULL;
-    do
-    {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if(item->is_selected)
-        {
-            if(!files)
-                files = fm_file_info_list_new();
-            fm_file_info_list_push_tail(files, item->fi);
-        }
-    }
-    while(gtk_tree_model_iter_next(model, &it));
+    files = fm_file_info_list_new();
+    for (l = desktop->selected.head; l; l = l->next)
+        fm_file_info_list_push_tail(files, ((FmDesktopItem*)l->data)->fi);
     return files;
 }
 
 static FmPathList* _dup_selected_file_paths(FmFolderView* fv)
 {
     FmDesktop* desktop = FM_DESKTOP(fv);
-    FmPathList* files = NULL;
-    GtkTreeModel* model;
-    GtkTreeIter it;
+    FmPathList* files;
+    GList* l;
 
-    if (!desktop->model)
+    if (desktop->selected.length == 0)
         return NULL;
-    model = GTK_TREE_MODEL(desktop->model);
-    if(!gtk_tree_model_get_iter_first(model, &it))
-        return NULL;
-    do
-    {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if(item->is_selected)
-        {
-            if(!files)
-                files = fm_path_list_new();
-            fm_path_list_push_tail(files, fm_file_info_get_path(item->fi));
-        }
-    }
-    while(gtk_tree_model_iter_next(model, &it));
+    files = fm_path_list_new();
+    for (l = desktop->selected.head; l; l = l->next)
+        fm_path_list_push_tail(files, fm_file_info_get_path(((FmDesktopItem*)l->data)->fi));
     return files;
 }
 
+/* adds area of item into rect which will be invalidated at once */
+static inline void _add_item_to_redraw(FmDesktopItem* item, GdkRectangle* rect,
+                                       gboolean *empty)
+{
+    GdkRectangle item_rect;
+
+    get_item_rect(item, &item_rect);
+    --item_rect.x;
+    --item_rect.y;
+    item_rect.width += 2;
+    item_rect.height += 2;
+    if (*empty)
+        *rect = item_rect;
+    else
+        gdk_rectangle_union(rect, &item_rect, rect);
+    *empty = FALSE;
+}
+
 static void _select_all(FmFolderView* fv)
 {
     FmDesktop* desktop = FM_DESKTOP(fv);
     GtkTreeIter it;
     GtkTreeModel* model;
+    GdkRectangle rect;
+    gboolean empty = TRUE;
 
     if (!desktop->model)
         return;
@@ -5268,36 +6028,34 @@ static void _select_all(FmFolderView* fv)
         FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
         if(!item->is_selected)
         {
-            item->is_selected = TRUE;
-            redraw_item(desktop, item);
-            fm_desktop_item_selected_changed(desktop, item);
+            set_item_selected(desktop, item, TRUE);
+            _add_item_to_redraw(item, &rect, &empty);
         }
     }
     while(gtk_tree_model_iter_next(model, &it));
+    if (empty) /* nothing was changed */
+        return;
+    gdk_window_invalidate_rect(gtk_widget_get_window(GTK_WIDGET(desktop)), &rect, FALSE);
+    fm_desktop_accessible_selection_changed(desktop);
 }
 
 static void _unselect_all(FmFolderView* fv)
 {
     FmDesktop* desktop = FM_DESKTOP(fv);
-    GtkTreeIter it;
-    GtkTreeModel* model;
+    FmDesktopItem* item;
+    GdkRectangle rect;
+    gboolean empty = TRUE;
 
-    if (!desktop->model)
-        return;
-    model = GTK_TREE_MODEL(desktop->model);
-    if(!gtk_tree_model_get_iter_first(model, &it))
-        return;
-    do
+    while (desktop->selected.head)
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if(item->is_selected)
-        {
-            item->is_selected = FALSE;
-            redraw_item(desktop, item);
-            fm_desktop_item_selected_changed(desktop, item);
-        }
+        item = desktop->selected.head->data;
+        set_item_selected(desktop, item, FALSE);
+        _add_item_to_redraw(item, &rect, &empty);
     }
-    while(gtk_tree_model_iter_next(model, &it));
+    if (empty) /* nothing was changed */
+        return;
+    gdk_window_invalidate_rect(gtk_widget_get_window(GTK_WIDGET(desktop)), &rect, FALSE);
+    fm_desktop_accessible_selection_changed(desktop);
 }
 
 static void _select_invert(FmFolderView* fv)
@@ -5802,6 +6560,273 @@ void fm_desktop_preference(GtkAction *act, FmDesktop *desktop)
 }
 
 
+/* ---------------------------------------------------------------------
+    Desktop startup
+
+    Startup of the desktop manager is done in three phases:
+      1) all desktops are shown with solid background color at once;
+      2) wallpapers for all monitors are decoded in parallel in threads;
+      3) desktop folders are loaded and icons are populated.
+    Each phase is timestamped with g_debug() since start of desktop manager
+    so it is possible to measure time until desktop is fully drawn. */
+
+typedef struct
+{
+    FmDesktop *desktop;
+    char *filename;
+    GdkPixbuf *pix;
+    guint generation;
+} FmWallpaperJob;
+
+/* max time (in seconds) to wait for wallpapers and folders on startup */
+#define STARTUP_TIMEOUT 15
+
+static void _startup_stamp(const char *phase)
+{
+    g_debug("desktop startup: %s in %.1f ms", phase,
+            (g_get_monotonic_time() - startup_time) / 1000.0);
+}
+
+static void _desktop_populate(FmDesktop *desktop)
+{
+    FmFolder *desktop_folder;
+
+    if (desktop->conf.folder)
+    {
+        if (desktop->conf.folder[0])
+            desktop_folder = fm_folder_from_path_name(desktop->conf.folder);
+        else
+            desktop_folder = NULL;
+    }
+    else
+        desktop_folder = fm_folder_from_path(fm_path_get_desktop());
+    if (desktop_folder)
+    {
+        connect_model(desktop, desktop_folder);
+        g_object_unref(desktop_folder);
+    }
+    else
+        /* we have to add popup here because it will be never
+           set by connect_model() as latter wasn't called */
+        fm_folder_view_add_popup(FM_FOLDER_VIEW(desktop),
+                                 GTK_WINDOW(desktop),
+                                 fm_desktop_update_popup);
+    if (desktop->model)
+#if FM_CHECK_VERSION(1, 0, 2)
+        fm_folder_model_set_sort(desktop->model,
+                                 desktop->conf.desktop_sort_by,
+                                 desktop->conf.desktop_sort_type);
+#else
+        gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
+                                             desktop->conf.desktop_sort_by,
+                                             desktop->conf.desktop_sort_type);
+#endif
+}
+
+static void _create_extra_items(void)
+{
+#if FM_CHECK_VERSION(1, 2, 0)
+    GFile *gf;
+
+    gf = fm_file_new_for_uri("trash:///");
+    if (g_file_query_exists(gf, NULL))
+        trash_can = _add_extra_item("trash:///");
+    else
+        trash_can = NULL;
+    if (G_LIKELY(trash_can))
+    {
+        trash_monitor = fm_monitor_directory(gf, NULL);
+        g_signal_connect(trash_monitor, "changed", G_CALLBACK(on_trash_changed), trash_can);
+    }
+    g_object_unref(gf);
+    documents = _add_extra_item(g_get_user_special_dir(G_USER_DIRECTORY_DOCUMENTS));
+    /* FIXME: support some other dirs */
+    vol_mon = g_volume_monitor_get();
+    if (G_LIKELY(vol_mon))
+    {
+        GList *ml = g_volume_monitor_get_mounts(vol_mon), *l;
+
+        /* if some mounts are already there, add them to own list */
+        for (l = ml; l; l = l->next)
+        {
+            GMount *mount = G_MOUNT(l->data);
+            on_mount_added(vol_mon, mount, NULL);
+            g_object_unref(mount);
+        }
+        g_list_free(ml);
+        g_signal_connect(vol_mon, "mount-added", G_CALLBACK(on_mount_added), NULL);
+        g_signal_connect(vol_mon, "mount-removed", G_CALLBACK(on_mount_removed), NULL);
+    }
+#endif
+}
+
+static void _startup_populate_icons(void)
+{
+    int i;
+
+    _startup_stamp("wallpapers are shown");
+    startup_desktops = 0;
+    for (i = 0; i < n_screens; i++)
+    {
+        if (desktops[i]->monitor < 0)
+            continue;
+        _desktop_populate(desktops[i]);
+        if (desktops[i]->model)
+        {
+            desktops[i]->startup_pending = TRUE;
+            startup_desktops++;
+            /* the folder might be loaded already so ensure layout */
+            queue_layout_items(desktops[i]);
+        }
+        else if (desktops[i]->snapshot)
+        {
+            /* no desktop folder anymore so snapshot is useless */
+            free_snapshot(desktops[i]);
+            gtk_widget_queue_draw(GTK_WIDGET(desktops[i]));
+        }
+    }
+    _create_extra_items();
+    if (startup_desktops == 0)
+        _startup_desktop_drawn();
+}
+
+static void _startup_finish(const char *phase)
+{
+    _startup_stamp(phase);
+    startup_time = 0;
+    if (startup_timeout)
+    {
+        g_source_remove(startup_timeout);
+        startup_timeout = 0;
+    }
+}
+
+static void _startup_desktop_drawn(void)
+{
+    if (startup_time == 0 || --startup_desktops > 0)
+        return;
+    _startup_finish("desktop is fully drawn");
+}
+
+/* desktop is drawn, destroyed, or its folder failed to load */
+static void _startup_desktop_done(FmDesktop *desktop)
+{
+    if (!desktop->startup_pending)
+        return;
+    desktop->startup_pending = FALSE;
+    _startup_desktop_drawn();
+}
+
+static gboolean on_startup_timeout(gpointer user_data)
+{
+    int i;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    startup_timeout = 0;
+    if (startup_wallpapers > 0)
+    {
+        /* decoding hangs: drop the jobs and show everything right away */
+        startup_generation++;
+        startup_wallpapers = 0;
+        for (i = 0; i < n_screens; i++)
+            if (desktops[i]->wallpaper_pending)
+            {
+                desktops[i]->wallpaper_pending = FALSE;
+                update_background(desktops[i], -1);
+            }
+        _startup_populate_icons();
+    }
+    /* folders which are not loaded yet will be shown when ready */
+    for (i = 0; i < n_screens; i++)
+        desktops[i]->startup_pending = FALSE;
+    if (startup_time != 0)
+        _startup_finish("startup timed out");
+    return FALSE;
+}
+
+static gboolean on_wallpaper_decoded(gpointer user_data)
+{
+    FmWallpaperJob *job = user_data;
+    FmDesktop *desktop = job->desktop;
+
+    /* ignore the job if manager was restarted or startup timed out */
+    if (job->generation == startup_generation)
+    {
+        /* desktop might be destroyed but the job should be counted still */
+        if (desktop->icon_render != NULL)
+        {
+            desktop->wallpaper_pending = FALSE;
+            _clear_preloaded_wallpaper(desktop);
+            if (job->pix)
+            {
+                desktop->preloaded_pix = job->pix;
+                desktop->preloaded_file = job->filename;
+                job->pix = NULL;
+                job->filename = NULL;
+            }
+            /* it takes preloaded image if wallpaper is still the same */
+            update_background(desktop, -1);
+            _clear_preloaded_wallpaper(desktop);
+        }
+        if (--startup_wallpapers == 0)
+            _startup_populate_icons();
+    }
+    if (job->pix)
+        g_object_unref(job->pix);
+    g_free(job->filename);
+    g_object_unref(desktop);
+    g_slice_free(FmWallpaperJob, job);
+    return FALSE;
+}
+
+static void _wallpaper_decode_thread(gpointer data, gpointer _unused)
+{
+    FmWallpaperJob *job = data;
+
+    job->pix = gdk_pixbuf_new_from_file(job->filename, NULL);
+    gdk_threads_add_idle(on_wallpaper_decoded, job);
+}
+
+static void _startup_decode_wallpapers(void)
+{
+    GThreadPool *pool = NULL;
+    FmWallpaperJob *job;
+    const char *wallpaper;
+    int i;
+
+    _startup_stamp("solid background is shown");
+    startup_wallpapers = 0;
+    for (i = 0; i < n_screens; i++)
+    {
+        if (!desktops[i]->wallpaper_pending)
+            continue;
+        wallpaper = get_current_wallpaper(desktops[i]);
+        if (wallpaper == NULL)
+        {
+            desktops[i]->wallpaper_pending = FALSE;
+            continue;
+        }
+        if (pool == NULL)
+            /* decode all wallpapers at once, one thread per monitor */
+            pool = g_thread_pool_new(_wallpaper_decode_thread, NULL,
+                                     n_screens, FALSE, NULL);
+        job = g_slice_new(FmWallpaperJob);
+        job->desktop = g_object_ref(desktops[i]);
+        job->filename = g_strdup(wallpaper);
+        job->pix = NULL;
+        job->generation = startup_generation;
+        startup_wallpapers++;
+        g_thread_pool_push(pool, job, NULL);
+    }
+    if (pool)
+        /* the pool will be freed after the last job is done */
+        g_thread_pool_free(pool, FALSE, FALSE);
+    else
+        _startup_populate_icons();
+}
+
+
 /* ---------------------------------------------------------------------
     Interface functions */
 
@@ -5810,9 +6835,13 @@ void fm_desktop_manager_init(gint on_screen)
     GdkDisplay * gdpy;
     int i, n_scr, n_mon, scr, mon;
     const char* desktop_path;
-#if FM_CHECK_VERSION(1, 2, 0)
-    GFile *gf;
-#endif
+
+    startup_time = g_get_monotonic_time();
+    startup_generation++;
+    if (startup_timeout)
+        g_source_remove(startup_timeout);
+    startup_timeout = gdk_threads_add_timeout_seconds(STARTUP_TIMEOUT,
+                                                      on_startup_timeout, NULL);
 
     if(! win_group)
         win_group = gtk_window_group_new();
@@ -5833,49 +6862,21 @@ void fm_desktop_manager_init(gint on_screen)
     {
         GdkScreen* screen = gdk_display_get_screen(gdpy, scr);
         n_mon = gdk_screen_get_n_monitors(screen);
+        if(on_screen < 0 || on_screen == (int)scr)
+            g_signal_connect(screen, "monitors-changed",
+                             G_CALLBACK(on_monitors_changed), NULL);
         for(mon = 0; mon < n_mon; mon++)
         {
             gint mon_init = (on_screen < 0 || on_screen == (int)scr) ? (int)mon : (mon ? -2 : -1);
             FmDesktop *desktop = fm_desktop_new(screen, mon_init);
             GtkWidget *widget = GTK_WIDGET(desktop);
-            FmFolder *desktop_folder;
 
             desktops[i++] = desktop;
             if(mon_init < 0)
                 continue;
             /* realize it: without this, setting wallpaper or font won't work */
             gtk_widget_realize(widget);
-            /* realizing also loads config */
-            if (desktop->conf.folder)
-            {
-                if (desktop->conf.folder[0])
-                    desktop_folder = fm_folder_from_path_name(desktop->conf.folder);
-                else
-                    desktop_folder = NULL;
-            }
-            else
-                desktop_folder = fm_folder_from_path(fm_path_get_desktop());
-            if (desktop_folder)
-            {
-                connect_model(desktop, desktop_folder);
-                g_object_unref(desktop_folder);
-            }
-            else
-                /* we have to add popup here because it will be never
-                   set by connect_model() as latter wasn't called */
-                fm_folder_view_add_popup(FM_FOLDER_VIEW(desktop),
-                                         GTK_WINDOW(desktop),
-                                         fm_desktop_update_popup);
-            if (desktop->model)
-#if FM_CHECK_VERSION(1, 0, 2)
-                fm_folder_model_set_sort(desktop->model,
-                                         desktop->conf.desktop_sort_by,
-                                         desktop->conf.desktop_sort_type);
-#else
-                gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
-                                                     desktop->conf.desktop_sort_by,
-                                                     desktop->conf.desktop_sort_type);
-#endif
+            /* realizing also loads config and sets solid background */
             gtk_widget_show_all(widget);
             gdk_window_lower(gtk_widget_get_window(widget));
         }
@@ -5885,44 +6886,15 @@ void fm_desktop_manager_init(gint on_screen)
 
     hand_cursor = gdk_cursor_new(GDK_HAND2);
 
-#if FM_CHECK_VERSION(1, 2, 0)
-    /* create extra items */
-    gf = fm_file_new_for_uri("trash:///");
-    if (g_file_query_exists(gf, NULL))
-        trash_can = _add_extra_item("trash:///");
-    else
-        trash_can = NULL;
-    if (G_LIKELY(trash_can))
-    {
-        trash_monitor = fm_monitor_directory(gf, NULL);
-        g_signal_connect(trash_monitor, "changed", G_CALLBACK(on_trash_changed), trash_can);
-    }
-    g_object_unref(gf);
-    documents = _add_extra_item(g_get_user_special_dir(G_USER_DIRECTORY_DOCUMENTS));
-    /* FIXME: support some other dirs */
-    vol_mon = g_volume_monitor_get();
-    if (G_LIKELY(vol_mon))
-    {
-        GList *ml = g_volume_monitor_get_mounts(vol_mon), *l;
-
-        /* if some mounts are already there, add them to own list */
-        for (l = ml; l; l = l->next)
-        {
-            GMount *mount = G_MOUNT(l->data);
-            on_mount_added(vol_mon, mount, NULL);
-            g_object_unref(mount);
-        }
-        g_list_free(ml);
-        g_signal_connect(vol_mon, "mount-added", G_CALLBACK(on_mount_added), NULL);
-        g_signal_connect(vol_mon, "mount-removed", G_CALLBACK(on_mount_removed), NULL);
-    }
-#endif
+    /* decode wallpapers and then populate icons and create extra items */
+    _startup_decode_wallpapers();
 
     pcmanfm_ref();
 }
 
 void fm_desktop_manager_finalize()
 {
+    GdkDisplay *gdpy;
     int i;
 
     if (idle_config_save)
@@ -5930,11 +6902,24 @@ void fm_desktop_manager_finalize()
         g_source_remove(idle_config_save);
         idle_config_save = 0;
     }
+    /* cancel startup if it's still in progress */
+    startup_generation++;
+    startup_time = 0;
+    if (startup_timeout)
+    {
+        g_source_remove(startup_timeout);
+        startup_timeout = 0;
+    }
+    gdpy = gdk_display_get_default();
+    for(i = 0; i < gdk_display_get_n_screens(gdpy); i++)
+        g_signal_handlers_disconnect_by_func(gdk_display_get_screen(gdpy, i),
+                                             on_monitors_changed, NULL);
     for(i = 0; i < n_screens; i++)
     {
         gtk_widget_destroy(GTK_WIDGET(desktops[i]));
     }
     g_free(desktops);
+    desktops = NULL;
     n_screens = 0;
     g_object_unref(win_group);
     win_group = NULL;
@@ -5983,16 +6968,13 @@ void fm_desktop_manager_finalize()
 
 FmDesktop* fm_desktop_get(gint screen, gint monitor)
 {
-    int i = 0, n = 0;
-    while(i < n_screens && n <= screen)
-    {
-        if(n == screen && desktops[i]->monitor == monitor)
+    int i;
+
+    /* desktops added by on_monitors_changed() are not grouped by screen */
+    for(i = 0; i < n_screens; i++)
+        if(desktops[i]->monitor == monitor &&
+           gdk_screen_get_number(gtk_widget_get_screen(GTK_WIDGET(desktops[i]))) == screen)
             return desktops[i];
-        i++;
-        if(i < n_screens &&
-           (desktops[i]->monitor == 0 || desktops[i]->monitor == -1))
-            n++;
-    }
     return NULL;
 }
 
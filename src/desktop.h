@@ -44,6 +44,7 @@ G_BEGIN_DECLS
 typedef struct _FmDesktop           FmDesktop;
 typedef struct _FmDesktopClass      FmDesktopClass;
 typedef struct _FmDesktopItem       FmDesktopItem;
+typedef struct _FmDesktopSnapshotItem FmDesktopSnapshotItem;
 typedef struct _FmBackgroundCache   FmBackgroundCache;
 
 struct _FmDesktop
@@ -66,6 +67,7 @@ struct _FmDesktop
     guint cell_h;
     GdkRectangle working_area;
     FmDesktopItem* focus;
+    GQueue selected; /* selected items in order of selecting */
     FmDesktopItem* drop_hilight;
     FmDesktopItem* hover_item;
     gint rubber_bending_x;
@@ -76,15 +78,28 @@ struct _FmDesktop
     gboolean forward_pending : 1;
     gboolean dragging : 1;
     gboolean layout_pending : 1;
+    gboolean wallpaper_pending : 1; /* startup: wallpaper isn't decoded yet */
+    gboolean startup_pending : 1; /* startup: icons weren't drawn yet */
+    gboolean atk_pending : 1; /* accessible objects aren't created yet */
+    gboolean unplugged : 1; /* monitor is disconnected, desktop is hidden */
     guint idle_layout;
+    guint batch_timeout; /* to handle inserted rows once per batch */
+    GArray *atk_added; /* GtkTreeIter of rows inserted since last sync */
+    guint batch_size;
+    gint64 batch_start;
     FmDndSrc* dnd_src;
     FmDndDest* dnd_dest;
     guint single_click_timeout_handler;
     guint button_pressed;
     FmFolderModel* model;
     guint cur_desktop;
+    gint n_desktops; /* cached _NET_NUMBER_OF_DESKTOPS, -1 if unknown */
+    guint workarea_timeout; /* to handle root events once per frame */
     gint monitor;
     FmBackgroundCache *cache;
+    GdkPixbuf *preloaded_pix; /* wallpaper decoded in background on startup */
+    char *preloaded_file;
+    GSList *snapshot; /* items layout from previous session */
 #if GTK_CHECK_VERSION(3, 0, 0)
     GtkCssProvider *css;
 #endif
@@ -113,6 +128,7 @@ void        fm_desktop_wallpaper_changed(FmDesktop *desktop);
 
 void fm_desktop_manager_init(gint on_screen);
 void fm_desktop_manager_finalize();
+void fm_desktop_manager_save_snapshots(void);
 
 G_END_DECLS
 
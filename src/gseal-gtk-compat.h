@@ -61,6 +61,7 @@ G_BEGIN_DECLS
 #if !GTK_CHECK_VERSION (2, 18, 0)
 #define gtk_widget_has_focus(widget)            GTK_WIDGET_HAS_FOCUS(widget)
 #define gtk_widget_get_visible(widget)          GTK_WIDGET_VISIBLE(widget)
+#define gtk_widget_get_allocation(widget, alloc) (*(alloc) = (widget)->allocation)
 #endif /* GTK+ < 2.18.0 */
 
 #if !GLIB_CHECK_VERSION(2, 28, 0)
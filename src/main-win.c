@@ -255,6 +255,12 @@ static void update_sort_menu(FmMainWin* win)
         return;
     if(!fm_folder_model_get_sort(fm_folder_view_get_model(fv), &by, &mode))
         return;
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* sorting by custom column (i.e. by fuzzy match score) is temporary
+       and is not reflected in menu nor saved into config */
+    if(by >= FM_FOLDER_MODEL_N_COLS)
+        return;
+#endif
     type = FM_SORT_IS_ASCENDING(mode) ? GTK_SORT_ASCENDING : GTK_SORT_DESCENDING;
     /* we don't handle extended modes in radio actions so do that here */
     if(mode != win->current_page->sort_type)
@@ -1060,6 +1066,9 @@ static void fm_main_win_destroy(GtkObject *object)
     /* Gtk+ runs destroy method twice */
     if(win->win_group)
     {
+        /* the last window is closed, remember what was open */
+        if (all_wins && all_wins->next == NULL)
+            fm_main_win_save_session();
         g_signal_handlers_disconnect_by_func(win->location, on_location_activate, win);
         g_signal_handlers_disconnect_by_func(win->notebook, on_notebook_switch_page, win);
         g_signal_handlers_disconnect_by_func(win->notebook, on_notebook_page_added, win);
@@ -1657,9 +1666,8 @@ static void update_statusbar(FmMainWin* win)
         gtk_widget_hide(GTK_WIDGET(win->vol_status));
 }
 
-gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
+static gint _append_tab_page(FmMainWin* win, FmTabPage* page)
 {
-    FmTabPage* page = fm_tab_page_new(path);
     GtkWidget* gpage = GTK_WIDGET(page);
     FmTabLabel* label = page->tab_label;
     FmFolderView* folder_view = fm_tab_page_get_folder_view(page);
@@ -1676,11 +1684,18 @@ gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
     ret = gtk_notebook_append_page(win->notebook, gpage, GTK_WIDGET(page->tab_label));
     gtk_widget_show_all(gpage);
     gtk_notebook_set_tab_reorderable(win->notebook, gpage, TRUE);
-    gtk_notebook_set_current_page(win->notebook, ret);
 
     return ret;
 }
 
+gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
+{
+    gint ret = _append_tab_page(win, fm_tab_page_new(path));
+
+    gtk_notebook_set_current_page(win->notebook, ret);
+    return ret;
+}
+
 static gboolean on_window_state_event(GtkWidget *widget, GdkEventWindowState *evt, FmMainWin *win)
 {
     if (evt->changed_mask & GDK_WINDOW_STATE_FULLSCREEN)
@@ -1702,8 +1717,9 @@ FmMainWin* fm_main_win_add_win(FmMainWin* win, FmPath* path)
         gtk_window_maximize(GTK_WINDOW(win));
     gtk_widget_show_all(GTK_WIDGET(win));
     g_signal_connect(win, "window-state-event", G_CALLBACK(on_window_state_event), win);
-    /* create new tab */
-    fm_main_win_add_tab(win, path);
+    /* create new tab; if path is NULL then caller will add tabs itself */
+    if (path)
+        fm_main_win_add_tab(win, path);
     gtk_window_present(GTK_WINDOW(win));
     /* set toolbar visibility and menu toggleables from config */
     act = gtk_ui_manager_get_action(win->ui, "/menubar/ViewMenu/Toolbar/ShowToolbar");
@@ -2219,6 +2235,24 @@ static inline FmTabPage *_find_tab_page(FmMainWin *win, FmFolderView *fv)
     return NULL;
 }
 
+/* only current and passive pages are shown, others may defer updates */
+static void _update_pages_activity(FmMainWin *win)
+{
+    FmFolderView *passive_view = NULL;
+    FmTabPage *page;
+    gint n;
+
+    if (win->enable_passive_view && win->current_page)
+        passive_view = fm_tab_page_get_passive_view(win->current_page);
+    for (n = gtk_notebook_get_n_pages(win->notebook); n > 0; )
+    {
+        page = FM_TAB_PAGE(gtk_notebook_get_nth_page(win->notebook, --n));
+        fm_tab_page_set_active(page, page == win->current_page ||
+                                     (passive_view != NULL &&
+                                      fm_tab_page_get_folder_view(page) == passive_view));
+    }
+}
+
 static void on_notebook_switch_page(GtkNotebook* nb, gpointer* new_page, guint num, FmMainWin* win)
 {
     GtkWidget* sw_page = gtk_notebook_get_nth_page(nb, num);
@@ -2227,6 +2261,8 @@ static void on_notebook_switch_page(GtkNotebook* nb, gpointer* new_page, guint n
 
     g_return_if_fail(FM_IS_TAB_PAGE(sw_page));
     page = (FmTabPage*)sw_page;
+    /* restored tabs open their folders only when shown first time */
+    fm_tab_page_load_pending(page);
     /* deactivate gestures from old view first */
     if(win->folder_view)
     {
@@ -2273,6 +2309,8 @@ static void on_notebook_switch_page(GtkNotebook* nb, gpointer* new_page, guint n
         /* FIXME: log errors */
         fm_tab_page_take_view_back(page);
     }
+    /* pages which were hidden update their status now */
+    _update_pages_activity(win);
 
     /* reactivate gestures */
     fm_folder_view_set_active(win->folder_view, TRUE);
@@ -2587,7 +2625,9 @@ static void on_filter(GtkAction* act, FmMainWin* win)
     char *new_filter;
 
     new_filter = fm_get_user_input(GTK_WINDOW(win), _("Select filter"),
-                                   _("Choose a new shell pattern to show files:"),
+                                   _("Choose a new shell pattern to show files\n"
+                                     "(start it with '~' for fuzzy matching, or with '\\~'\n"
+                                     "to match names starting with '~'):"),
                                    old_filter);
     if (!new_filter) /* cancelled */
         return;
@@ -2653,6 +2693,8 @@ static void on_dual_pane(GtkToggleAction* act, FmMainWin* win)
             g_debug("on_dual_pane: adding passive page %d to left pane", num - 2);
             page = gtk_notebook_get_nth_page(win->notebook, num - 2);
         }
+        /* the page might be restored but not shown yet */
+        fm_tab_page_load_pending(FM_TAB_PAGE(page));
         fv = fm_tab_page_get_folder_view(FM_TAB_PAGE(page));
         fm_tab_page_set_passive_view(win->current_page, fv,
                                      win->passive_view_on_right);
@@ -2675,6 +2717,183 @@ static void on_dual_pane(GtkToggleAction* act, FmMainWin* win)
         }
         win->enable_passive_view = FALSE;
     }
+    _update_pages_activity(win);
+}
+
+static char *_get_session_file(void)
+{
+    char *dir = pcmanfm_get_profile_dir(TRUE);
+    char *path = g_build_filename(dir, "session", NULL);
+
+    g_free(dir);
+    return path;
+}
+
+/* saves windows, tabs, scroll positions and dual pane state of all windows */
+void fm_main_win_save_session(void)
+{
+    GKeyFile *kf;
+    GSList *wins, *l;
+    char *file, *data, group[32];
+    gsize len;
+    int i = 0;
+
+    if (!app_config->restore_session || all_wins == NULL)
+        return;
+    kf = g_key_file_new();
+    /* the most recently active window should be restored last to be on top */
+    wins = g_slist_reverse(g_slist_copy(all_wins));
+    for (l = wins; l; l = l->next)
+    {
+        FmMainWin *win = l->data;
+        gint n = gtk_notebook_get_n_pages(win->notebook), k, w, h;
+        FmFolderView *passive = NULL;
+        FmTabPage *page;
+        char **tabs;
+        gint *scroll;
+
+        if (n == 0)
+            continue;
+        tabs = g_new0(char*, n + 1);
+        scroll = g_new(gint, n);
+        for (k = 0; k < n; k++)
+        {
+            FmPath *path;
+
+            page = FM_TAB_PAGE(gtk_notebook_get_nth_page(win->notebook, k));
+            path = fm_tab_page_get_cwd(page);
+            if (path == NULL)
+                path = fm_path_get_home();
+            tabs[k] = fm_path_to_str(path);
+            scroll[k] = fm_tab_page_get_scroll_pos(page);
+        }
+        g_snprintf(group, sizeof(group), "window%d", i++);
+        if (win->maximized || win->fullscreen)
+        {
+            w = app_config->win_width;
+            h = app_config->win_height;
+        }
+        else
+            gtk_window_get_size(GTK_WINDOW(win), &w, &h);
+        g_key_file_set_integer(kf, group, "width", w);
+        g_key_file_set_integer(kf, group, "height", h);
+        g_key_file_set_boolean(kf, group, "maximized", win->maximized);
+        g_key_file_set_string_list(kf, group, "tabs", (const gchar * const *)tabs, n);
+        g_key_file_set_integer_list(kf, group, "scroll", scroll, n);
+        g_key_file_set_integer(kf, group, "current",
+                               gtk_notebook_get_current_page(win->notebook));
+        if (win->enable_passive_view && win->current_page)
+            passive = fm_tab_page_get_passive_view(win->current_page);
+        if (passive && (page = _find_tab_page(win, passive)) != NULL)
+        {
+            g_key_file_set_integer(kf, group, "passive",
+                                   gtk_notebook_page_num(win->notebook, GTK_WIDGET(page)));
+            g_key_file_set_boolean(kf, group, "passive_on_right",
+                                   win->passive_view_on_right);
+        }
+        g_strfreev(tabs);
+        g_free(scroll);
+    }
+    g_slist_free(wins);
+    data = g_key_file_to_data(kf, &len, NULL);
+    file = _get_session_file();
+    g_file_set_contents(file, data, len, NULL);
+    g_free(file);
+    g_free(data);
+    g_key_file_free(kf);
+}
+
+static void _restore_passive_view(FmMainWin *win, gint num, gboolean on_right)
+{
+    FmTabPage *page = FM_TAB_PAGE(gtk_notebook_get_nth_page(win->notebook, num));
+    GtkAction *act;
+
+    fm_tab_page_load_pending(page);
+    if (!fm_tab_page_set_passive_view(win->current_page,
+                                      fm_tab_page_get_folder_view(page), on_right))
+        return;
+    gtk_widget_set_state(GTK_WIDGET(page->tab_label), GTK_STATE_SELECTED);
+    win->passive_view_on_right = on_right;
+    win->enable_passive_view = TRUE;
+    _update_pages_activity(win);
+    /* on_dual_pane() will do nothing since passive view is enabled already */
+    act = gtk_ui_manager_get_action(win->ui, "/menubar/ViewMenu/DualPane");
+    gtk_toggle_action_set_active(GTK_TOGGLE_ACTION(act), TRUE);
+}
+
+/* reopens windows saved by fm_main_win_save_session(), only current tab
+   of each window loads its folder, others will do that when shown.
+   Returns the last created window or NULL if there was nothing to restore. */
+FmMainWin* fm_main_win_restore_session(void)
+{
+    GKeyFile *kf;
+    FmMainWin *win = NULL;
+    char *file, **groups = NULL;
+    gsize n_groups = 0, i;
+
+    if (!app_config->restore_session)
+        return NULL;
+    kf = g_key_file_new();
+    file = _get_session_file();
+    if (g_key_file_load_from_file(kf, file, G_KEY_FILE_NONE, NULL))
+        groups = g_key_file_get_groups(kf, &n_groups);
+    g_free(file);
+    for (i = 0; i < n_groups; i++)
+    {
+        const char *group = groups[i];
+        gsize n = 0, n_scroll = 0, k;
+        char **tabs = g_key_file_get_string_list(kf, group, "tabs", &n, NULL);
+        gint *scroll, w, h, cur;
+
+        if (tabs == NULL || n == 0)
+        {
+            g_strfreev(tabs);
+            continue;
+        }
+        scroll = g_key_file_get_integer_list(kf, group, "scroll", &n_scroll, NULL);
+        win = fm_main_win_add_win(NULL, NULL);
+        w = g_key_file_get_integer(kf, group, "width", NULL);
+        h = g_key_file_get_integer(kf, group, "height", NULL);
+        if (w > 0 && h > 0)
+            gtk_window_resize(GTK_WINDOW(win), w, h);
+        if (g_key_file_get_boolean(kf, group, "maximized", NULL))
+            gtk_window_maximize(GTK_WINDOW(win));
+        else
+            gtk_window_unmaximize(GTK_WINDOW(win));
+        /* first appended page becomes current, don't let it load the folder */
+        g_signal_handlers_block_by_func(win->notebook, on_notebook_switch_page, win);
+        for (k = 0; k < n; k++)
+        {
+            FmPath *path = fm_path_new_for_str(tabs[k]);
+
+            _append_tab_page(win, fm_tab_page_new_lazy(path,
+                                                       k < n_scroll ? scroll[k] : 0));
+            fm_path_unref(path);
+        }
+        g_signal_handlers_unblock_by_func(win->notebook, on_notebook_switch_page, win);
+        cur = g_key_file_get_integer(kf, group, "current", NULL);
+        if (cur < 0 || cur >= (gint)n)
+            cur = 0;
+        if (cur == gtk_notebook_get_current_page(win->notebook))
+            on_notebook_switch_page(win->notebook, NULL, cur, win);
+        else
+            gtk_notebook_set_current_page(win->notebook, cur);
+        if (g_key_file_has_key(kf, group, "passive", NULL))
+        {
+            gint num = g_key_file_get_integer(kf, group, "passive", NULL);
+
+            if (num >= 0 && num < (gint)n && num != cur)
+                _restore_passive_view(win, num,
+                                      g_key_file_get_boolean(kf, group,
+                                                             "passive_on_right",
+                                                             NULL));
+        }
+        g_strfreev(tabs);
+        g_free(scroll);
+    }
+    g_strfreev(groups);
+    g_key_file_free(kf);
+    return win;
 }
 
 static void on_show_status(GtkToggleAction *action, FmMainWin *win)
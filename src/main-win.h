@@ -87,6 +87,9 @@ void fm_main_win_chdir_by_name(FmMainWin* win, const char* path_str);
 gint fm_main_win_add_tab(FmMainWin* win, FmPath* path);
 FmMainWin* fm_main_win_add_win(FmMainWin* win, FmPath* path);
 
+void fm_main_win_save_session(void);
+FmMainWin* fm_main_win_restore_session(void);
+
 FmMainWin* fm_main_win_get_last_active(void);
 void fm_main_win_open_in_last_active(FmPath* path);
 
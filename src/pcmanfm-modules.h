@@ -26,16 +26,29 @@
 #define __PCMANFM_MODULES_H__
 
 #include <libfm/fm.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
-#define FM_MODULE_tab_page_status_VERSION 1
+#define FM_MODULE_tab_page_status_VERSION 2
+
+/**
+ * FmTabPageStatusReady:
+ * @message: (allow-none) (transfer full): text to add to status or %NULL
+ * @data: data passed to @sel_message_async callback
+ *
+ * Callback to pass result of @sel_message_async callback to the page.
+ */
+typedef void (*FmTabPageStatusReady)(char *message, gpointer data);
 
 /**
  * FmTabPageStatusInit:
  * @init: (allow-none): once-done initialization callback
  * @finalize: (allow-none): once-done finalization callback
- * @sel_message: callback to make selection-specific statusbar addition
+ * @sel_message: (allow-none): callback to make selection-specific statusbar addition
+ * @sel_message_async: (allow-none): asynchronous variant of @sel_message
+ * @mime_types: (allow-none): %NULL-terminated list of file types of interest
+ * @timeout: time in milliseconds the page waits for @sel_message_async result
  *
  * The structure describing callbacks for FmTabPage statusbar update
  * extension specific for some file type - tab_page_status plugins.
@@ -43,7 +56,22 @@ G_BEGIN_DECLS
  * The @sel_message callback is called when the page statusbar for the
  * selected files is about to be updated so module may add some specific
  * message to the end of the status text. Returned text should either be
- * allocated or %NULL.
+ * allocated or %NULL. Since it is called synchronously it should be fast.
+ *
+ * If module needs to do some I/O to make its message (for example, read
+ * image dimensions) then it should set @sel_message_async instead. That
+ * callback should start the work and return immediately. Once the work is
+ * done it should call @ready with @data in the main thread exactly once,
+ * even if @cancellable was cancelled. Rapid selection changes are merged
+ * so the callback is called only after selection is settled for a while.
+ * If result is not ready in @timeout milliseconds (if it's 0 then default
+ * of one second is used) then @cancellable is cancelled and the result
+ * will be ignored. Module should add a reference on @files if it uses
+ * them after return.
+ *
+ * If @mime_types is set then callbacks will receive only files of those
+ * types (type may be also like "image/*") and will not be called at all
+ * if none of the selected files match.
  *
  * The @init callback is done once on module loading. It it exists then
  * it should return %TRUE after successful initialization.
@@ -57,6 +85,12 @@ typedef struct {
     gboolean (*init)(void);
     void (*finalize)(void);
     char * (*sel_message)(FmFileInfoList *files, gint n_files);
+    /* since version 2 */
+    void (*sel_message_async)(FmFileInfoList *files, gint n_files,
+                              GCancellable *cancellable,
+                              FmTabPageStatusReady ready, gpointer data);
+    const char * const *mime_types;
+    guint timeout;
 } FmTabPageStatusInit;
 
 extern FmTabPageStatusInit fm_module_init_tab_page_status;
@@ -69,6 +69,7 @@ static gboolean find_files = FALSE;
 #endif
 static char* ipc_cwd = NULL;
 static char* window_role = NULL;
+static char* trace_path = NULL;
 
 static int n_pcmanfm_ref = 0;
 
@@ -78,6 +79,7 @@ static GOptionEntry opt_entries[] =
     { "profile", 'p', 0, G_OPTION_ARG_STRING, &profile, N_("Name of configuration profile"), N_("PROFILE") },
     { "daemon-mode", 'd', 0, G_OPTION_ARG_NONE, &daemon_mode, N_("Run PCManFM as a daemon"), NULL },
     { "no-desktop", '\0', 0, G_OPTION_ARG_NONE, &no_desktop, N_("No function. Just to be compatible with nautilus"), NULL },
+    { "trace", '\0', 0, G_OPTION_ARG_FILENAME, &trace_path, N_("Write trace of folder navigation into FILE"), N_("FILE") },
 
     /* options that are acceptable for every instance of pcmanfm and will be passed through IPC. */
     { "desktop", '\0', 0, G_OPTION_ARG_NONE, &show_desktop, N_("Launch desktop manager"), NULL },
@@ -180,12 +182,20 @@ GList *_tab_page_modules = NULL;
 
 static gboolean fm_module_callback_tab_page_status(const char *name, gpointer init, int ver)
 {
-    /* add module callbacks into own data list */
-    if (((FmTabPageStatusInit*)init)->sel_message == NULL)
-        return FALSE;
-    if (((FmTabPageStatusInit*)init)->init && !((FmTabPageStatusInit*)init)->init())
+    FmTabPageStatusInit *module;
+
+    /* add module callbacks into own data list, fields which were added
+       in later versions are left unset for older modules */
+    module = g_slice_new0(FmTabPageStatusInit);
+    memcpy(module, init, ver < 2 ? G_STRUCT_OFFSET(FmTabPageStatusInit, sel_message_async)
+                                 : sizeof(FmTabPageStatusInit));
+    if ((module->sel_message == NULL && module->sel_message_async == NULL) ||
+        (module->init && !module->init()))
+    {
+        g_slice_free(FmTabPageStatusInit, module);
         return FALSE;
-    _tab_page_modules = g_list_append(_tab_page_modules, init);
+    }
+    _tab_page_modules = g_list_append(_tab_page_modules, module);
     return TRUE;
 }
 #endif
@@ -221,7 +231,7 @@ int main(int argc, char** argv)
     /* ensure that there is only one instance of pcmanfm. */
     inst.prog_name = "pcmanfm";
     inst.cb = single_inst_cb;
-    inst.opt_entries = opt_entries + 3;
+    inst.opt_entries = opt_entries + 4;
     inst.screen_num = gdk_x11_get_default_screen();
     switch(single_inst_init(&inst))
     {
@@ -235,6 +245,12 @@ int main(int argc, char** argv)
     case SINGLE_INST_SERVER: ; /* FIXME */
     }
 
+    /* the variable is checked for the case when options are not accessible */
+    if (trace_path == NULL && g_getenv("PCMANFM_TRACE"))
+        trace_path = g_strdup(g_getenv("PCMANFM_TRACE"));
+    if (trace_path)
+        pcmanfm_trace_init(trace_path);
+
     if(pipe(signal_pipe) == 0)
     {
         GIOChannel* ch = g_io_channel_unix_new(signal_pipe[0]);
@@ -291,13 +307,20 @@ int main(int argc, char** argv)
             g_source_remove(save_config_idle);
             save_config_idle = 0;
         }
+        /* windows are still open if we were terminated by a signal */
+        fm_main_win_save_session();
+        fm_desktop_manager_save_snapshots();
+        fm_tab_page_save_caches();
         fm_volume_manager_finalize();
     }
 
 #if FM_CHECK_VERSION(1, 2, 0)
     for (l = _tab_page_modules; l; l = l->next)
+    {
         if (((FmTabPageStatusInit*)l->data)->finalize)
             ((FmTabPageStatusInit*)l->data)->finalize();
+        g_slice_free(FmTabPageStatusInit, l->data);
+    }
     fm_module_unregister_type("tab_page_status");
     g_list_free(_tab_page_modules);
     _tab_page_modules = NULL;
@@ -307,6 +330,7 @@ int main(int argc, char** argv)
     fm_gtk_finalize();
 
     g_object_unref(config);
+    pcmanfm_trace_finalize();
     return 0;
 }
 
@@ -483,15 +507,21 @@ gboolean pcmanfm_run(gint screen_num)
         {
             /* If we're not in daemon mode, or pcmanfm_run() is called because another
              * instance send signal to us, open cwd by default. */
-            FmPath* path;
-            char* cwd = ipc_cwd ? ipc_cwd : g_get_current_dir();
-            path = fm_path_new_for_path(cwd);
-            win = fm_main_win_add_win(NULL, path);
-            if(new_win && window_role)
-                gtk_window_set_role(GTK_WINDOW(win), window_role);
-            fm_path_unref(path);
-            g_free(cwd);
-            ipc_cwd = NULL;
+            /* on the first start reopen windows from last session instead */
+            if (first_run)
+                win = fm_main_win_restore_session();
+            if (win == NULL)
+            {
+                FmPath* path;
+                char* cwd = ipc_cwd ? ipc_cwd : g_get_current_dir();
+                path = fm_path_new_for_path(cwd);
+                win = fm_main_win_add_win(NULL, path);
+                if(new_win && window_role)
+                    gtk_window_set_role(GTK_WINDOW(win), window_role);
+                fm_path_unref(path);
+                g_free(cwd);
+                ipc_cwd = NULL;
+            }
         }
     }
 
@@ -693,3 +723,104 @@ char* pcmanfm_get_profile_dir(gboolean create)
         g_mkdir_with_parents(dir, 0700);
     return dir;
 }
+
+/* ---------------------------------------------------------------------
+    Tracing of folder navigation */
+
+/* events are collected in memory and written in chunks of this size */
+#define TRACE_BUFFER_SIZE 32768
+
+gboolean pcmanfm_tracing = FALSE;
+static FILE *trace_file = NULL;
+static GString *trace_buf = NULL;
+static gint64 trace_start_time;
+static gboolean trace_empty;
+
+/* opens @path to write events in Chrome JSON trace format which can be
+   loaded into Perfetto UI or chrome://tracing */
+void pcmanfm_trace_init(const char *path)
+{
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL)
+    {
+        g_warning("cannot open trace file %s", path);
+        return;
+    }
+    trace_buf = g_string_sized_new(TRACE_BUFFER_SIZE + 1024);
+    g_string_append(trace_buf, "[\n");
+    trace_empty = TRUE;
+    trace_start_time = g_get_monotonic_time();
+    pcmanfm_tracing = TRUE;
+}
+
+static void _trace_flush(void)
+{
+    fwrite(trace_buf->str, 1, trace_buf->len, trace_file);
+    fflush(trace_file);
+    g_string_truncate(trace_buf, 0);
+}
+
+void pcmanfm_trace_finalize(void)
+{
+    if (!pcmanfm_tracing)
+        return;
+    pcmanfm_tracing = FALSE;
+    g_string_append(trace_buf, "\n]\n");
+    _trace_flush();
+    fclose(trace_file);
+    trace_file = NULL;
+    g_string_free(trace_buf, TRUE);
+    trace_buf = NULL;
+}
+
+/* returns start time for pcmanfm_trace_span(), or 0 if not tracing */
+gint64 pcmanfm_trace_now(void)
+{
+    return pcmanfm_tracing ? g_get_monotonic_time() : 0;
+}
+
+/* records span @name started at @start and ended now; spans with the same
+   @id (e.g. a tab page) are shown on the same track; @n_files and @detail
+   are added to event arguments if they are not negative and NULL */
+void pcmanfm_trace_span(const char *name, gconstpointer id, gint64 start,
+                        gint n_files, const char *detail)
+{
+    gint64 end;
+    const char *c;
+
+    if (!pcmanfm_tracing || start == 0)
+        return;
+    end = g_get_monotonic_time();
+    if (!trace_empty)
+        g_string_append(trace_buf, ",\n");
+    trace_empty = FALSE;
+    g_string_append_printf(trace_buf, "{\"name\":\"%s\",\"cat\":\"navigation\","
+                                      "\"ph\":\"b\",\"id\":\"%p\",\"pid\":%d,"
+                                      "\"tid\":1,\"ts\":%" G_GINT64_FORMAT "},\n",
+                           name, id, (int)getpid(), start - trace_start_time);
+    g_string_append_printf(trace_buf, "{\"name\":\"%s\",\"cat\":\"navigation\","
+                                      "\"ph\":\"e\",\"id\":\"%p\",\"pid\":%d,"
+                                      "\"tid\":1,\"ts\":%" G_GINT64_FORMAT ","
+                                      "\"args\":{\"us\":%" G_GINT64_FORMAT,
+                           name, id, (int)getpid(), end - trace_start_time,
+                           end - start);
+    if (n_files >= 0)
+        g_string_append_printf(trace_buf, ",\"files\":%d", n_files);
+    if (detail)
+    {
+        g_string_append(trace_buf, ",\"detail\":\"");
+        for (c = detail; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                g_string_append_c(trace_buf, '\\');
+            if ((guchar)*c < 0x20)
+                g_string_append_printf(trace_buf, "\\u%04x", (guint)*c);
+            else
+                g_string_append_c(trace_buf, *c);
+        }
+        g_string_append_c(trace_buf, '"');
+    }
+    g_string_append(trace_buf, "}}");
+    if (trace_buf->len >= TRACE_BUFFER_SIZE)
+        _trace_flush();
+}
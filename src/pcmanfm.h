@@ -48,6 +48,14 @@ void pcmanfm_save_config(gboolean immediate);
 gboolean pcmanfm_can_open_path_in_terminal(FmPath* dir);
 void pcmanfm_open_folder_in_terminal(GtkWindow* parent, FmPath* dir);
 
+/* tracing of folder navigation, enabled by --trace=FILE or PCMANFM_TRACE */
+extern gboolean pcmanfm_tracing;
+void pcmanfm_trace_init(const char *path);
+void pcmanfm_trace_finalize(void);
+gint64 pcmanfm_trace_now(void);
+void pcmanfm_trace_span(const char *name, gconstpointer id, gint64 start,
+                        gint n_files, const char *detail);
+
 G_END_DECLS
 
 #endif
@@ -24,6 +24,7 @@
 
 #include <libfm/fm-gtk.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "app-config.h"
 #include "main-win.h"
@@ -32,6 +33,7 @@
 #include "gseal-gtk-compat.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <fnmatch.h>
 
 /* Additional entries for FmFileMenu popup */
@@ -80,9 +82,40 @@ static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page);
 static void on_folder_removed(FmFolder* folder, FmTabPage* page);
 static void on_folder_unmount(FmFolder* folder, FmTabPage* page);
 static void on_folder_content_changed(FmFolder* folder, FmTabPage* page);
+static void on_folder_files_added(FmFolder* folder, GSList* files, FmTabPage* page);
+static void on_folder_files_removed(FmFolder* folder, GSList* files, FmTabPage* page);
+static void _set_view_model(FmTabPage* page, FmFolderModel* model);
+static void _attach_folder_model(FmTabPage* page, FmFolder* folder);
+static void _queue_update_scroll(FmTabPage* page);
+static void _cancel_scroll_restore(FmTabPage *page);
+static void _restore_scroll_pos(FmTabPage *page, gdouble pos);
+static void _set_history_scroll_pos(FmTabPage* page, int scroll_pos);
+#if FM_CHECK_VERSION(1, 2, 0)
+static void _reconcile_cached_listing(FmTabPage *page, GSList *files);
+static void _drop_stale_file(FmTabPage *page, const char *name, FmFileInfo *cached);
+static void _drop_stale_filter_key(gpointer name, gpointer cached, gpointer page);
+static void on_folder_loaded_save_listing(FmFolder *folder, FmTabPage *page);
+static void _cancel_revalidate(FmTabPage *page);
+#endif
 static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErrorSeverity severity, FmTabPage* page);
+#if FM_CHECK_VERSION(1, 0, 2)
+static void on_folder_files_changed(FmFolder *folder, GSList *files, FmTabPage *page);
+static void on_batch_files_changed(FmFolder *folder, GSList *files, FmTabPage *page);
+static void fm_tab_page_filter_free(FmTabPageFilter *filter);
+static void _cancel_filter_chunks(FmTabPage *page);
+static void _stop_model_batching(FmTabPage *page);
+static void _check_change_storm(FmTabPage *page, guint n);
+static void _cancel_change_storm(FmTabPage *page);
+static void _drop_page_snapshots(FmTabPage *page);
+static gboolean fm_tab_page_path_filter(FmFileInfo *file, gpointer user_data);
+static void _apply_model_filters(FmFolderModel *model);
+static void fm_tab_page_update_sort(FmTabPage *page, FmFolderModel *model);
+#endif
 
 static void on_folder_view_sel_changed(FmFolderView* fv, gint n_sel, FmTabPage* page);
+static void _reset_sel_status(FmTabPage* page, gint n_sel);
+static void _prefetch_path(FmTabPage *page, FmPath *path);
+static void _queue_prefetch(void);
 #if FM_CHECK_VERSION(1, 2, 0)
 static void  on_folder_view_columns_changed(FmFolderView *fv, FmTabPage *page);
 #endif
@@ -99,6 +132,15 @@ static void fm_tab_page_realize(GtkWidget *page);
 static void fm_tab_page_unrealize(GtkWidget *page);
 
 static GQuark popup_qdata;
+static gint loading_pages = 0; /* folders prefetch waits while it's not 0 */
+
+#if FM_CHECK_VERSION(1, 2, 0)
+/* model which is sorted or gets a row now, see _get_fuzzy_score() */
+static FmFolderModel *sorting_model = NULL;
+static GQuark fuzzy_sort_qdata; /* FmFolderModel -> FmTabPage which scores it */
+static FmFolderModelCol score_column = FM_FOLDER_MODEL_COL_DEFAULT;
+static void _register_score_column(void);
+#endif
 
 G_DEFINE_TYPE(FmTabPage, fm_tab_page, GTK_TYPE_HPANED)
 
@@ -168,6 +210,11 @@ static void fm_tab_page_class_init(FmTabPageClass *klass)
                     G_TYPE_NONE, 0);
 
     popup_qdata = g_quark_from_static_string("tab-page::popup-filelist");
+#if FM_CHECK_VERSION(1, 2, 0)
+    fuzzy_sort_qdata = g_quark_from_static_string("tab-page::fuzzy-sort");
+    /* register it before any view columns are read from config */
+    _register_score_column();
+#endif
 }
 
 
@@ -183,22 +230,40 @@ static void fm_tab_page_finalize(GObject *object)
 
     for(i = 0; i < FM_STATUS_TEXT_NUM; ++i)
         g_free(page->status_text[i]);
+    if (page->pending_path)
+        fm_path_unref(page->pending_path);
 
 #if FM_CHECK_VERSION(1, 0, 2)
     g_free(page->filter_pattern);
+    if (page->filter)
+        fm_tab_page_filter_free(page->filter);
 #endif
-
     G_OBJECT_CLASS(fm_tab_page_parent_class)->finalize(object);
 }
 
 static void free_folder(FmTabPage* page)
 {
+    /* new folder will get a model as usual */
+    page->detached = FALSE;
     /* page might be just loaded so stop updating it in any case */
     if(page->update_scroll_id)
     {
         g_source_remove(page->update_scroll_id);
         page->update_scroll_id = 0;
     }
+    _cancel_scroll_restore(page);
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (page->progressive_id)
+    {
+        g_source_remove(page->progressive_id);
+        page->progressive_id = 0;
+    }
+    _cancel_change_storm(page);
+    _stop_model_batching(page);
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    _cancel_revalidate(page);
+#endif
     if(page->folder)
     {
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_start_loading, page);
@@ -208,6 +273,15 @@ static void free_folder(FmTabPage* page)
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_content_changed, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_removed, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_unmount, page);
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_files_added, page);
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_files_removed, page);
+#if FM_CHECK_VERSION(1, 0, 2)
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_files_changed, page);
+        g_signal_handlers_disconnect_by_func(page->folder, on_batch_files_changed, page);
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_loaded_save_listing, page);
+#endif
         g_object_unref(page->folder);
         page->folder = NULL;
 #if FM_CHECK_VERSION(1, 2, 0)
@@ -216,6 +290,14 @@ static void free_folder(FmTabPage* page)
         page->want_focus = NULL;
 #endif
     }
+#if FM_CHECK_VERSION(1, 0, 2)
+    _cancel_filter_chunks(page);
+    if (page->filter_keys)
+    {
+        g_hash_table_destroy(page->filter_keys);
+        page->filter_keys = NULL;
+    }
+#endif
 }
 
 /* workaround on FmStandardView: it should forward focus-in events but doesn't do */
@@ -280,7 +362,17 @@ void fm_tab_page_destroy(GtkObject *object)
 
     g_debug("fm_tab_page_destroy, folder: %s",
             page->folder ? fm_path_get_basename(fm_folder_get_path(page->folder)) : "(none)");
+#if FM_CHECK_VERSION(1, 0, 2)
+    _drop_page_snapshots(page);
+#endif
     free_folder(page);
+    if (page->busy)
+    {
+        /* folder loading is not followed anymore */
+        page->busy = FALSE;
+        loading_pages--;
+        _queue_prefetch();
+    }
     if(page->nav_history)
     {
         g_object_unref(page->nav_history);
@@ -316,6 +408,13 @@ void fm_tab_page_destroy(GtkObject *object)
         g_object_unref(page->folder_view);
         page->folder_view = NULL;
     }
+    /* folder view is gone so it only drops our reference on model */
+    _set_view_model(page, NULL);
+    if (page->update_status_id)
+    {
+        g_source_remove(page->update_status_id);
+        page->update_status_id = 0;
+    }
 #if FM_CHECK_VERSION(1, 0, 2)
     g_strfreev(page->columns);
     page->columns = NULL;
@@ -325,6 +424,18 @@ void fm_tab_page_destroy(GtkObject *object)
         g_source_remove(page->update_scroll_id);
         page->update_scroll_id = 0;
     }
+    _cancel_scroll_restore(page);
+    if (page->sel_update_id)
+    {
+        g_source_remove(page->sel_update_id);
+        page->sel_update_id = 0;
+    }
+    if (page->detach_id)
+    {
+        g_source_remove(page->detach_id);
+        page->detach_id = 0;
+    }
+    _reset_sel_status(page, 0);
 #if FM_CHECK_VERSION(1, 2, 0)
     fm_side_pane_set_popup_updater(page->side_pane, NULL, NULL);
 #endif
@@ -343,9 +454,19 @@ void fm_tab_page_destroy(GtkObject *object)
 #endif
 }
 
-static void on_folder_content_changed(FmFolder* folder, FmTabPage* page)
+/* ---------------------------------------------------------------------
+    Folder status */
+
+/* status text is updated no more often than once per frame */
+#define STATUS_UPDATE_TIME 16
+
+static void update_status_text(FmTabPage* page)
 {
-    /* update status text */
+    if (page->update_status_id)
+    {
+        g_source_remove(page->update_status_id);
+        page->update_status_id = 0;
+    }
     g_free(page->status_text[FM_STATUS_TEXT_NORMAL]);
     page->status_text[FM_STATUS_TEXT_NORMAL] = format_status_text(page);
     g_signal_emit(page, signals[STATUS], 0,
@@ -353,239 +474,3230 @@ static void on_folder_content_changed(FmFolder* folder, FmTabPage* page)
                   page->status_text[FM_STATUS_TEXT_NORMAL]);
 }
 
-static void on_folder_view_sel_changed(FmFolderView* fv, gint n_sel, FmTabPage* page)
+static gboolean on_update_status_text(gpointer user_data)
 {
-    char* msg = page->status_text[FM_STATUS_TEXT_SELECTED_FILES];
-    GString *str;
-    g_free(msg);
+    FmTabPage* page = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    page->update_status_id = 0;
+    update_status_text(page);
+    return FALSE;
+}
+
+static inline void queue_update_status_text(FmTabPage* page)
+{
+    /* hidden page will update it once when shown */
+    if (page->inactive)
+        page->status_dirty = TRUE;
+    else if (page->update_status_id == 0)
+        page->update_status_id = gdk_threads_add_timeout(STATUS_UPDATE_TIME,
+                                                         on_update_status_text,
+                                                         page);
+}
+
+#if FM_CHECK_VERSION(1, 0, 2)
+/* ---------------------------------------------------------------------
+    Batched model updates */
+
+/* Adding rows into a model which is set to the view is slow since all the
+   handlers of the view are called for each row. While a big folder is
+   loaded or changed rapidly, handlers of the model on the folder are
+   blocked and changes are queued. Few changes are added into the model one
+   by one, no longer than a part of a frame so the view is redrawn between.
+   Many changes are added with the model detached from the view, and that
+   is done only when they are at least half as many as rows shown, so the
+   view takes all rows again only few times while the folder is loaded.
+   Hidden pages queue changes the same way and add them once when shown. */
+
+/* if folder isn't loaded in that time (ms) then show what is loaded */
+#define PROGRESSIVE_LOAD_DELAY 100
+/* time (in ms) per frame which is spent on adding rows */
+#define MODEL_BATCH_FRAME_TIME 8
+/* more queued changes than that are added with the view detached */
+#define MODEL_BATCH_DETACH_MIN 256
+/* if more changes are queued while page is hidden then model is created
+   from scratch when the page is shown */
+#define MODEL_BATCH_HIDDEN_MAX 2000
+
+typedef enum
+{
+    MODEL_BATCH_ADD,
+    MODEL_BATCH_REMOVE,
+    MODEL_BATCH_CHANGE
+} FmModelBatchOp;
+
+typedef struct
+{
+    FmModelBatchOp op;
+    FmFileInfo *fi;
+} FmModelBatchEvent;
+
+static void _free_model_batch_event(FmModelBatchEvent *ev)
+{
+    fm_file_info_unref(ev->fi);
+    g_slice_free(FmModelBatchEvent, ev);
+}
 
-    if(n_sel > 0)
+static void _apply_model_batch_event(FmTabPage *page, FmModelBatchEvent *ev)
+{
+    switch (ev->op)
     {
-        str = g_string_sized_new(64);
-        /* FIXME: display total size of all selected files. */
-        if(n_sel == 1) /* only one file is selected */
-        {
-            FmFileInfoList* files = fm_folder_view_dup_selected_files(fv);
-            FmFileInfo* fi = fm_file_info_list_peek_head(files);
-            const char* size_str = fm_file_info_get_disp_size(fi);
+    case MODEL_BATCH_ADD:
+        fm_folder_model_file_created(page->model, ev->fi);
+        break;
+    case MODEL_BATCH_REMOVE:
+        fm_folder_model_file_deleted(page->model, ev->fi);
+        break;
+    case MODEL_BATCH_CHANGE:
+        fm_folder_model_file_changed(page->model, ev->fi);
+        break;
+    }
+    _free_model_batch_event(ev);
+}
+
 #if FM_CHECK_VERSION(1, 2, 0)
-            GList *l;
+/* selects @files in the view again after its model was replaced */
+static void _reselect_files(FmTabPage *page, FmFileInfoList *files)
+{
+    GList *l;
+
+    if (files == NULL)
+        return;
+    for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+        fm_folder_view_select_file_path(page->folder_view,
+                                        fm_file_info_get_path(l->data));
+    fm_file_info_list_unref(files);
+}
 #endif
-            if(size_str)
-            {
-                g_string_printf(str, "\"%s\" (%s) %s",
-                            fm_file_info_get_disp_name(fi),
-                            size_str ? size_str : "",
-                            fm_file_info_get_desc(fi));
-            }
-            else
-            {
-                g_string_printf(str, "\"%s\" %s",
-                            fm_file_info_get_disp_name(fi),
-                            fm_file_info_get_desc(fi));
-            }
+
+/* adds all queued changes while the model is not set to the view */
+static void _apply_model_batch_detached(FmTabPage *page)
+{
+    FmFolderModel *model = page->model;
+    GtkAdjustment *adj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view));
+    /* keep the position which is being restored yet */
+    gdouble pos = page->scroll_adj ? page->scroll_target : gtk_adjustment_get_value(adj);
+    FmModelBatchEvent *ev;
 #if FM_CHECK_VERSION(1, 2, 0)
-            /* ---- statusbar plugins support ---- */
-            CHECK_MODULES();
-            for (l = _tab_page_modules; l; l = l->next)
-            {
-                FmTabPageStatusInit *module = l->data;
-                char *message = module->sel_message(files, n_sel);
-                if (message && message[0])
-                {
-                    g_string_append_c(str, ' ');
-                    g_string_append(str, message);
-                }
-                g_free(message);
-            }
+    FmFileInfoList *files = fm_folder_view_dup_selected_files(page->folder_view);
 #endif
-            fm_file_info_list_unref(files);
-        }
-        else
-        {
-            FmFileInfoList* files;
-            goffset sum;
-            GList *l;
-            char size_str[128];
-
-            g_string_printf(str, ngettext("%d item selected", "%d items selected", n_sel), n_sel);
-            /* don't count if too many files are selected, that isn't lightweight */
-            if (n_sel < 1000)
-            {
-                sum = 0;
-                files = fm_folder_view_dup_selected_files(fv);
-                for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
-                {
-                    if (fm_file_info_is_dir(l->data))
-                    {
-                        /* if we got a directory then we cannot tell it's size
-                           unless we do deep count but we cannot afford it */
-                        sum = -1;
-                        break;
-                    }
-                    sum += fm_file_info_get_size(l->data);
-                }
-                if (sum >= 0)
-                {
-                    fm_file_size_to_str(size_str, sizeof(size_str), sum,
-                                        fm_config->si_unit);
-                    g_string_append_printf(str, " (%s)", size_str);
-                }
+
+    fm_folder_view_set_model(page->folder_view, NULL);
+    while ((ev = g_queue_pop_head(page->batch_events)) != NULL)
+        _apply_model_batch_event(page, ev);
+    fm_folder_view_set_model(page->folder_view, model);
 #if FM_CHECK_VERSION(1, 2, 0)
-                /* ---- statusbar plugins support ---- */
-                CHECK_MODULES();
-                for (l = _tab_page_modules; l; l = l->next)
-                {
-                    FmTabPageStatusInit *module = l->data;
-                    char *message = module->sel_message(files, n_sel);
-                    if (message && message[0])
-                    {
-                        g_string_append_c(str, ' ');
-                        g_string_append(str, message);
-                    }
-                    g_free(message);
-                }
-#endif
-                fm_file_info_list_unref(files);
-            }
-            /* FIXME: can we show some more info on selection?
-               that isn't lightweight if a lot of files are selected */
-        }
-        msg = g_string_free(str, FALSE);
+    _reselect_files(page, files);
+#endif
+    _restore_scroll_pos(page, pos);
+}
+
+static gboolean on_model_batch_idle(gpointer user_data)
+{
+    FmTabPage *page = user_data;
+    FmModelBatchEvent *ev;
+    gint64 deadline;
+    guint n;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    /* nobody sees it, fm_tab_page_set_active() will continue */
+    if (page->inactive)
+    {
+        page->batch_id = 0;
+        return FALSE;
+    }
+    n = g_queue_get_length(page->batch_events);
+    if (n >= MODEL_BATCH_DETACH_MIN && n >= (guint)page->n_shown / 2)
+        _apply_model_batch_detached(page);
+    else if (n >= MODEL_BATCH_DETACH_MIN && !fm_folder_is_loaded(page->folder))
+    {
+        /* rows come faster than they can be inserted one by one so wait
+           until there are enough of them, see on_folder_finish_loading() */
+        page->batch_id = 0;
+        return FALSE;
     }
     else
-        msg = NULL;
-    page->status_text[FM_STATUS_TEXT_SELECTED_FILES] = msg;
-    g_signal_emit(page, signals[STATUS], 0,
-                  (guint)FM_STATUS_TEXT_SELECTED_FILES, msg);
+    {
+        deadline = g_get_monotonic_time() + MODEL_BATCH_FRAME_TIME * 1000;
+        while ((ev = g_queue_pop_head(page->batch_events)) != NULL)
+        {
+            _apply_model_batch_event(page, ev);
+            /* let the view be redrawn */
+            if (g_get_monotonic_time() >= deadline)
+                return TRUE;
+        }
+    }
+    page->batch_id = 0;
+    /* folder is loaded and all is done, let the model follow it again */
+    if (fm_folder_is_loaded(page->folder) && !page->storm)
+    {
+        gboolean scroll = page->scroll_after_batch;
+
+        pcmanfm_trace_span("rows shown", page, page->trace_load, page->n_shown, NULL);
+        _stop_model_batching(page);
+        /* rows are all in place now */
+        if (scroll)
+            _queue_update_scroll(page);
+    }
+    return FALSE;
 }
 
-#if FM_CHECK_VERSION(1, 2, 0)
-static void  on_folder_view_columns_changed(FmFolderView *fv, FmTabPage *page)
+static void _queue_model_batch(FmTabPage *page, FmModelBatchOp op, GSList *files)
 {
-    GSList *columns = fm_folder_view_get_columns(fv), *l;
-    char **cols;
-    guint i;
+    FmModelBatchEvent *ev;
 
-    if (columns == NULL)
+    if (page->batch_events == NULL || page->resync_on_show)
         return;
-    i = g_slist_length(columns);
-    cols = g_new(char *, i+1);
-    for (i = 0, l = columns; l; i++, l = l->next)
+    if (page->inactive && g_queue_get_length(page->batch_events) > MODEL_BATCH_HIDDEN_MAX)
     {
-        FmFolderViewColumnInfo *info = l->data;
+        g_queue_foreach(page->batch_events, (GFunc)_free_model_batch_event, NULL);
+        g_queue_clear(page->batch_events);
+        page->resync_on_show = TRUE;
+        return;
+    }
+    for (; files; files = files->next)
+    {
+        ev = g_slice_new(FmModelBatchEvent);
+        ev->op = op;
+        ev->fi = fm_file_info_ref(files->data);
+        g_queue_push_tail(page->batch_events, ev);
+    }
+    /* while storm lasts changes are applied periodically instead */
+    if (page->batch_id == 0 && !page->storm && !page->inactive)
+        page->batch_id = gdk_threads_add_idle_full(G_PRIORITY_DEFAULT_IDLE,
+                                                   on_model_batch_idle, page, NULL);
+}
 
-        if (info->width > 0)
-            cols[i] = g_strdup_printf("%s:%d",
-                                      fm_folder_model_col_get_name(info->col_id),
-                                      info->width);
-        else
-            cols[i] = g_strdup(fm_folder_model_col_get_name(info->col_id));
+static void on_batch_files_changed(FmFolder *folder, GSList *files, FmTabPage *page)
+{
+    _queue_model_batch(page, MODEL_BATCH_CHANGE, files);
+    _check_change_storm(page, g_slist_length(files));
+}
+
+static void _start_model_batching(FmTabPage *page)
+{
+    if (page->batch_events || page->model == NULL || page->folder == NULL)
+        return;
+    g_signal_handlers_block_matched(page->folder, G_SIGNAL_MATCH_DATA, 0, 0,
+                                    NULL, NULL, page->model);
+    page->batch_events = g_queue_new();
+}
+
+/* drops queued changes, it's called when model is replaced */
+static void _stop_model_batching(FmTabPage *page)
+{
+    page->scroll_after_batch = FALSE;
+    page->resync_on_show = FALSE;
+    if (page->batch_events == NULL)
+        return;
+    if (page->batch_id)
+    {
+        g_source_remove(page->batch_id);
+        page->batch_id = 0;
     }
-    g_slist_free(columns);
-    cols[i] = NULL; /* terminate the list */
-    if (page->own_config)
+    g_queue_foreach(page->batch_events, (GFunc)_free_model_batch_event, NULL);
+    g_queue_free(page->batch_events);
+    page->batch_events = NULL;
+    if (page->folder && page->model)
+        g_signal_handlers_unblock_matched(page->folder, G_SIGNAL_MATCH_DATA, 0, 0,
+                                          NULL, NULL, page->model);
+}
+
+/* Some folders get thousands of changes per second (build output, logs,
+   downloads). When that happens the page stops following each change and
+   instead applies all queued changes periodically, or simply creates the
+   model again if there are too many of them. */
+
+/* more than that many changes per second is a storm; the rate is a count
+   of changes which decays with time, so it follows changes in about last
+   second without a fixed window */
+#define CHANGE_STORM_RATE 200
+/* interval (ms) between updates of the model while storm lasts */
+#define CHANGE_STORM_SYNC_TIME 500
+/* if there are more queued changes then model is created from scratch */
+#define CHANGE_STORM_RESYNC_EVENTS 2000
+
+static gboolean on_change_storm_start(gpointer user_data);
+
+/* counts changes of loaded folder and detects start and end of a storm */
+static void _check_change_storm(FmTabPage *page, guint n)
+{
+    gint64 now;
+
+    if (page->model == NULL || page->folder == NULL || page->inactive ||
+        !fm_folder_is_loaded(page->folder) || fm_folder_is_incremental(page->folder))
+        return;
+    now = g_get_monotonic_time();
+    /* count loses half of its value in each second */
+    page->change_rate = page->change_rate * G_USEC_PER_SEC /
+                        (G_USEC_PER_SEC + (now - page->changes_time)) + n;
+    page->changes_time = now;
+    if (!page->storm && page->change_rate > CHANGE_STORM_RATE)
     {
-        g_strfreev(page->columns);
-        page->columns = cols;
-        fm_app_config_save_config_for_path(fm_folder_view_get_cwd(fv),
-                                           page->sort_type, page->sort_by, -1,
-                                           page->show_hidden, cols);
+        /* switching is done in on_change_storm_start() since we may be in
+           the middle of signal emission now and the model should get this
+           change from its own handler */
+        page->storm = TRUE;
+        if (page->storm_id == 0)
+            page->storm_id = gdk_threads_add_idle_full(G_PRIORITY_DEFAULT,
+                                                       on_change_storm_start,
+                                                       page, NULL);
+        queue_update_status_text(page);
     }
-    else
+    /* it was calm for a while, get back to following each change */
+    else if (page->storm && page->change_rate < CHANGE_STORM_RATE / 4)
     {
-        g_strfreev(app_config->columns);
-        app_config->columns = cols;
-        pcmanfm_save_config(FALSE);
+        page->storm = FALSE;
+        queue_update_status_text(page);
     }
 }
+
+/* creates model again, keeping selection and scroll position */
+static void _resync_folder_model(FmTabPage *page)
+{
+#if FM_CHECK_VERSION(1, 2, 0)
+    FmFileInfoList *files = fm_folder_view_dup_selected_files(page->folder_view);
 #endif
 
-static gboolean on_folder_view_focus_in(GtkWidget *widget, GdkEvent *event, FmTabPage *page)
+    _set_history_scroll_pos(page, fm_tab_page_get_scroll_pos(page));
+    _attach_folder_model(page, page->folder);
+#if FM_CHECK_VERSION(1, 2, 0)
+    _reselect_files(page, files);
+#endif
+    _queue_update_scroll(page);
+}
+
+static gboolean on_change_storm(gpointer user_data)
 {
-    g_signal_emit(page, signals[GOT_FOCUS], 0);
+    FmTabPage *page = user_data;
+    FmModelBatchEvent *ev;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    if (page->batch_events)
+    {
+        if (g_queue_get_length(page->batch_events) > CHANGE_STORM_RESYNC_EVENTS)
+            _resync_folder_model(page);
+        else while ((ev = g_queue_pop_head(page->batch_events)) != NULL)
+            _apply_model_batch_event(page, ev);
+    }
+    _check_change_storm(page, 0);
+    if (page->storm)
+    {
+        _start_model_batching(page);
+        return TRUE;
+    }
+    page->storm_id = 0;
+    _stop_model_batching(page);
     return FALSE;
 }
 
-static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErrorSeverity severity, FmTabPage* page)
+/* starts queueing changes right after the one which started the storm,
+   the queue is applied periodically by on_change_storm() */
+static gboolean on_change_storm_start(gpointer user_data)
 {
-    GtkWindow* win = GTK_WINDOW(GET_MAIN_WIN(page));
-    if(err->domain == G_IO_ERROR)
+    FmTabPage *page = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    if (!page->storm)
     {
-        if( err->code == G_IO_ERROR_NOT_MOUNTED && severity < FM_JOB_ERROR_CRITICAL )
-        {
-            FmPath* path = fm_folder_get_path(folder);
-            if(fm_mount_path(win, path, TRUE))
-                return FM_JOB_RETRY;
-        }
+        page->storm_id = 0;
+        return FALSE;
     }
-    if(severity >= FM_JOB_ERROR_MODERATE)
+    _start_model_batching(page);
+    page->storm_id = gdk_threads_add_timeout(CHANGE_STORM_SYNC_TIME,
+                                             on_change_storm, page);
+    return FALSE;
+}
+
+static void _cancel_change_storm(FmTabPage *page)
+{
+    if (page->storm_id)
     {
-        /* Only show more severe errors to the users and
-         * ignore milder errors. Otherwise too many error
-         * message boxes can be annoying.
-         * This fixes bug #3411298- Show "Permission denied" when switching to super user mode.
-         * https://sourceforge.net/tracker/?func=detail&aid=3411298&group_id=156956&atid=801864
-         * */
-        fm_show_error(win, NULL, err->message);
+        g_source_remove(page->storm_id);
+        page->storm_id = 0;
     }
-    return FM_JOB_CONTINUE;
+    page->storm = FALSE;
+    page->change_rate = 0;
+    page->changes_time = 0;
 }
 
-static void fm_tab_page_realize(GtkWidget *page)
+/* folder is still loading, show what is loaded and add the rest in batches */
+static gboolean on_progressive_load(gpointer user_data)
 {
-    GTK_WIDGET_CLASS(fm_tab_page_parent_class)->realize(page);
-    if (FM_TAB_PAGE(page)->busy)
-        fm_set_busy_cursor(page);
+    FmTabPage *page = user_data;
+    gint64 trace_start;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    page->progressive_id = 0;
+    /* cached listing is shown or nobody sees the page */
+    if (page->model || page->inactive || page->detached ||
+        fm_folder_is_loaded(page->folder))
+        return FALSE;
+    trace_start = pcmanfm_trace_now();
+    _attach_folder_model(page, page->folder);
+    _start_model_batching(page);
+    pcmanfm_trace_span("model creation", page, trace_start, page->n_shown, NULL);
+    return FALSE;
 }
+#endif
 
-static void fm_tab_page_unrealize(GtkWidget *page)
+/* recounts files in folder and rows in model from scratch */
+static void _resync_status_counters(FmTabPage* page)
 {
-    if (FM_TAB_PAGE(page)->busy)
-        fm_unset_busy_cursor(page);
-    GTK_WIDGET_CLASS(fm_tab_page_parent_class)->unrealize(page);
+    page->n_files = page->folder ? fm_file_info_list_get_length(fm_folder_get_files(page->folder)) : 0;
+    page->n_shown = page->model ? gtk_tree_model_iter_n_children(GTK_TREE_MODEL(page->model), NULL) : 0;
 }
 
-static void _tab_set_busy_cursor(FmTabPage* page)
+static void on_model_row_inserted(GtkTreeModel *model, GtkTreePath *tp,
+                                  GtkTreeIter *it, FmTabPage* page)
 {
-    page->busy = TRUE;
-    if (gtk_widget_get_realized(GTK_WIDGET(page)))
-        fm_set_busy_cursor(GTK_WIDGET(page));
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* the row which was filtered is in place now */
+    sorting_model = NULL;
+#endif
+    page->n_shown++;
+    queue_update_status_text(page);
 }
 
-static void _tab_unset_busy_cursor(FmTabPage* page)
+#if FM_CHECK_VERSION(1, 2, 0)
+static void on_model_row_changed(GtkTreeModel *model, GtkTreePath *tp,
+                                 GtkTreeIter *it, FmTabPage* page)
 {
-    page->busy = FALSE;
-    if (gtk_widget_get_realized(GTK_WIDGET(page)))
-        fm_unset_busy_cursor(GTK_WIDGET(page));
+    sorting_model = NULL;
+}
+#endif
+
+static void on_model_row_deleted(GtkTreeModel *model, GtkTreePath *tp,
+                                 FmTabPage* page)
+{
+    page->n_shown--;
+    queue_update_status_text(page);
+}
+
+/* folder monitor tells us when '.directory' file is changed externally */
+static void _check_folder_config_changed(FmFolder *folder, GSList *files)
+{
+    for (; files; files = files->next)
+        if (strcmp(fm_path_get_basename(fm_file_info_get_path(files->data)),
+                   ".directory") == 0)
+        {
+            fm_app_config_invalidate_config_for_path(fm_folder_get_path(folder));
+            break;
+        }
+}
+
+static void on_folder_files_added(FmFolder* folder, GSList* files, FmTabPage* page)
+{
+    _check_folder_config_changed(folder, files);
+#if FM_CHECK_VERSION(1, 0, 2)
+    _queue_model_batch(page, MODEL_BATCH_ADD, files);
+    _check_change_storm(page, g_slist_length(files));
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    if (page->stale_files)
+        _reconcile_cached_listing(page, files);
+#endif
+    page->n_files += g_slist_length(files);
+    queue_update_status_text(page);
+}
+
+static void on_folder_files_removed(FmFolder* folder, GSList* files, FmTabPage* page)
+{
+#if FM_CHECK_VERSION(1, 2, 0)
+    GSList *l;
+#endif
+
+    _check_folder_config_changed(folder, files);
+#if FM_CHECK_VERSION(1, 0, 2)
+    _queue_model_batch(page, MODEL_BATCH_REMOVE, files);
+    _check_change_storm(page, g_slist_length(files));
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* the file might be shown while cached listing is reconciled, and
+       the row is of the cached file if it was found unchanged */
+    if (page->stale_files)
+        for (l = files; l; l = l->next)
+        {
+            const char *name = fm_path_get_basename(fm_file_info_get_path(l->data));
+            FmFileInfo *cached = g_hash_table_lookup(page->stale_files, name);
+
+            if (cached)
+            {
+                fm_folder_model_extra_file_remove(page->model, cached);
+                _drop_stale_file(page, name, cached);
+            }
+            else
+                fm_folder_model_extra_file_remove(page->model, l->data);
+        }
+#endif
+    page->n_files -= g_slist_length(files);
+    queue_update_status_text(page);
+}
+
+static void on_folder_content_changed(FmFolder* folder, FmTabPage* page)
+{
+    /* counters are updated already, just update status text */
+    queue_update_status_text(page);
+}
+
+/* sets model to the view and follows its rows for the status */
+static void _set_view_model(FmTabPage* page, FmFolderModel* model)
+{
+#if FM_CHECK_VERSION(1, 0, 2)
+    /* queued changes are for the old model */
+    _stop_model_batching(page);
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* cached listing is not shown anymore */
+    if (page->stale_files)
+    {
+        if (page->filter_keys)
+            g_hash_table_foreach(page->stale_files, _drop_stale_filter_key, page);
+        g_hash_table_destroy(page->stale_files);
+        page->stale_files = NULL;
+    }
+#endif
+    if (page->model)
+    {
+        g_signal_handlers_disconnect_by_func(page->model, on_model_row_inserted, page);
+        g_signal_handlers_disconnect_by_func(page->model, on_model_row_deleted, page);
+#if FM_CHECK_VERSION(1, 2, 0)
+        g_signal_handlers_disconnect_by_func(page->model, on_model_row_changed, page);
+        if (sorting_model == page->model)
+            sorting_model = NULL;
+#endif
+        g_object_unref(page->model);
+        page->model = NULL;
+    }
+    if (page->folder_view)
+        fm_folder_view_set_model(page->folder_view, model);
+    if (model)
+    {
+        page->model = g_object_ref(model);
+        g_signal_connect(model, "row-inserted",
+                         G_CALLBACK(on_model_row_inserted), page);
+        g_signal_connect(model, "row-deleted",
+                         G_CALLBACK(on_model_row_deleted), page);
+#if FM_CHECK_VERSION(1, 2, 0)
+        g_signal_connect(model, "row-changed",
+                         G_CALLBACK(on_model_row_changed), page);
+#endif
+    }
+    _resync_status_counters(page);
+}
+
+/* ---------------------------------------------------------------------
+    Deep count of selected folders */
+
+/* no more than that many folders are counted at once, to not starve
+   loading of folders from the same disk */
+#define SEL_COUNT_MAX_THREADS 2
+/* interval (in ms) between partial totals reported to the status */
+#define SEL_COUNT_REPORT_TIME 200
+/* max number of folders which size is kept in cache */
+#define DIR_SIZE_CACHE_MAX 32768
+/* version of the cache file format */
+#define DIR_SIZE_CACHE_VERSION 2
+#define DIR_SIZE_CACHE_TYPE "(ua(tttxtas))"
+
+struct _FmSelCountJob
+{
+    volatile gint n_ref;
+    FmTabPage *page; /* accessed in main thread only, NULL if cancelled */
+    GCancellable *cancellable;
+    GSList *dirs; /* GFile list */
+};
+
+typedef struct
+{
+    FmSelCountJob *job;
+    goffset size;
+    gboolean finished;
+} FmSelCountReport;
+
+/* size of files directly in a folder and names of its subfolders, cached
+   by device, inode and modification time of the folder; the time changes
+   when anything is created, deleted or renamed in the folder so each level
+   is validated separately; note that size of a file which was changed in
+   place is not noticed until something else is changed in its folder */
+typedef struct
+{
+    guint64 dev;
+    guint64 ino;
+    guint64 mtime;
+    gint64 size;
+    guint64 used; /* time (in seconds) when entry was used last */
+    char **subdirs;
+} FmDirSizeEntry;
+
+static GThreadPool *sel_count_pool = NULL;
+static GHashTable *dir_size_cache = NULL; /* FmDirSizeEntry -> itself */
+static gboolean dir_size_cache_dirty = FALSE;
+static guint dir_size_save_id = 0;
+G_LOCK_DEFINE_STATIC(dir_size_cache);
+
+static guint _dir_size_hash(gconstpointer key)
+{
+    const FmDirSizeEntry *entry = key;
+
+    return (guint)(entry->ino ^ (entry->ino >> 32) ^ entry->dev ^ entry->mtime);
+}
+
+static gboolean _dir_size_equal(gconstpointer a, gconstpointer b)
+{
+    const FmDirSizeEntry *e1 = a, *e2 = b;
+
+    return (e1->ino == e2->ino && e1->dev == e2->dev && e1->mtime == e2->mtime);
+}
+
+static void _free_dir_size(gpointer data)
+{
+    FmDirSizeEntry *entry = data;
+
+    g_strfreev(entry->subdirs);
+    g_slice_free(FmDirSizeEntry, entry);
+}
+
+static char *_get_dir_size_cache_file(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "pcmanfm", "dirsizes", NULL);
+}
+
+/* called in main thread before first count is started */
+static void _load_dir_size_cache(void)
+{
+    GVariant *cache;
+    GVariantIter *items;
+    FmDirSizeEntry *entry;
+    char *path, *data;
+    gsize len;
+    guint version;
+
+    dir_size_cache = g_hash_table_new_full(_dir_size_hash, _dir_size_equal,
+                                           _free_dir_size, NULL);
+    if (!app_config->deep_count_cache)
+        return;
+    path = _get_dir_size_cache_file();
+    if (!g_file_get_contents(path, &data, &len, NULL))
+    {
+        g_free(path);
+        return;
+    }
+    g_free(path);
+    /* GVariant is safe against corrupted data so no validation is needed */
+    cache = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(DIR_SIZE_CACHE_TYPE),
+                                                       data, len, FALSE,
+                                                       g_free, data));
+    g_variant_get(cache, DIR_SIZE_CACHE_TYPE, &version, &items);
+    if (version == DIR_SIZE_CACHE_VERSION)
+    {
+        entry = g_slice_new(FmDirSizeEntry);
+        while (g_hash_table_size(dir_size_cache) < DIR_SIZE_CACHE_MAX &&
+               g_variant_iter_next(items, "(tttxt^as)", &entry->dev, &entry->ino,
+                                   &entry->mtime, &entry->size, &entry->used,
+                                   &entry->subdirs))
+        {
+            g_hash_table_replace(dir_size_cache, entry, entry);
+            entry = g_slice_new(FmDirSizeEntry);
+        }
+        g_slice_free(FmDirSizeEntry, entry);
+    }
+    g_variant_iter_free(items);
+    g_variant_unref(cache);
+}
+
+/* dirty flag is set by count threads */
+static gboolean _is_dir_size_cache_dirty(void)
+{
+    gboolean dirty;
+
+    G_LOCK(dir_size_cache);
+    dirty = dir_size_cache_dirty;
+    G_UNLOCK(dir_size_cache);
+    return dirty;
+}
+
+static void _save_dir_size_cache(void)
+{
+    GHashTableIter it;
+    gpointer key;
+    GArray *entries;
+    GVariantBuilder items;
+    GVariant *cache;
+    char *path, *dir;
+    guint i;
+
+    /* count threads wait only while entries are copied */
+    G_LOCK(dir_size_cache);
+    entries = g_array_sized_new(FALSE, FALSE, sizeof(FmDirSizeEntry),
+                                g_hash_table_size(dir_size_cache));
+    g_hash_table_iter_init(&it, dir_size_cache);
+    while (g_hash_table_iter_next(&it, &key, NULL))
+    {
+        FmDirSizeEntry entry = *(FmDirSizeEntry*)key;
+
+        entry.subdirs = g_strdupv(entry.subdirs);
+        g_array_append_val(entries, entry);
+    }
+    dir_size_cache_dirty = FALSE;
+    G_UNLOCK(dir_size_cache);
+    g_variant_builder_init(&items, G_VARIANT_TYPE("a(tttxtas)"));
+    for (i = 0; i < entries->len; i++)
+    {
+        FmDirSizeEntry *entry = &g_array_index(entries, FmDirSizeEntry, i);
+
+        g_variant_builder_add(&items, "(tttxt^as)", entry->dev, entry->ino,
+                              entry->mtime, entry->size, entry->used,
+                              entry->subdirs);
+        g_strfreev(entry->subdirs);
+    }
+    g_array_free(entries, TRUE);
+    cache = g_variant_ref_sink(g_variant_new(DIR_SIZE_CACHE_TYPE,
+                                             DIR_SIZE_CACHE_VERSION, &items));
+    path = _get_dir_size_cache_file();
+    dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_file_set_contents(path, g_variant_get_data(cache), g_variant_get_size(cache), NULL);
+    g_free(dir);
+    g_free(path);
+    g_variant_unref(cache);
+}
+
+static gboolean on_save_dir_size_cache(gpointer unused)
+{
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    dir_size_save_id = 0;
+    _save_dir_size_cache();
+    return FALSE;
+}
+
+/**
+ * fm_tab_page_save_caches
+ *
+ * Writes caches shared by all pages to disk if they have unsaved changes.
+ * Should be called before application exits.
+ */
+void fm_tab_page_save_caches(void)
+{
+    if (dir_size_save_id)
+    {
+        g_source_remove(dir_size_save_id);
+        dir_size_save_id = 0;
+    }
+    if (dir_size_cache && app_config->deep_count_cache && _is_dir_size_cache_dirty())
+        _save_dir_size_cache();
+}
+
+static gint _compare_dir_size_used(gconstpointer a, gconstpointer b)
+{
+    const FmDirSizeEntry *e1 = *(FmDirSizeEntry**)a, *e2 = *(FmDirSizeEntry**)b;
+
+    return (e1->used < e2->used) ? -1 : (e1->used > e2->used);
+}
+
+/* drops least recently used quarter of the cache, called with lock held */
+static void _evict_dir_sizes(void)
+{
+    GPtrArray *entries = g_ptr_array_sized_new(g_hash_table_size(dir_size_cache));
+    GHashTableIter it;
+    gpointer key;
+    guint i;
+
+    g_hash_table_iter_init(&it, dir_size_cache);
+    while (g_hash_table_iter_next(&it, &key, NULL))
+        g_ptr_array_add(entries, key);
+    g_ptr_array_sort(entries, _compare_dir_size_used);
+    for (i = 0; i < entries->len / 4; i++)
+        g_hash_table_remove(dir_size_cache, g_ptr_array_index(entries, i));
+    g_ptr_array_free(entries, TRUE);
+}
+
+/* fills @key from @dir info, returns FALSE if it has no inode */
+static gboolean _get_dir_size_key(GFile *dir, FmDirSizeEntry *key,
+                                  GCancellable *cancellable)
+{
+    GFileInfo *inf = g_file_query_info(dir, G_FILE_ATTRIBUTE_UNIX_DEVICE","
+                                            G_FILE_ATTRIBUTE_UNIX_INODE","
+                                            G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                       0, cancellable, NULL);
+    gboolean result = FALSE;
+
+    if (inf == NULL)
+        return FALSE;
+    if (g_file_info_has_attribute(inf, G_FILE_ATTRIBUTE_UNIX_INODE))
+    {
+        key->dev = g_file_info_get_attribute_uint32(inf, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+        key->ino = g_file_info_get_attribute_uint64(inf, G_FILE_ATTRIBUTE_UNIX_INODE);
+        key->mtime = g_file_info_get_attribute_uint64(inf, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+        result = TRUE;
+    }
+    g_object_unref(inf);
+    return result;
+}
+
+static void _sel_count_job_unref(FmSelCountJob *job)
+{
+    if (!g_atomic_int_dec_and_test(&job->n_ref))
+        return;
+    g_object_unref(job->cancellable);
+    g_slist_foreach(job->dirs, (GFunc)g_object_unref, NULL);
+    g_slist_free(job->dirs);
+    g_slice_free(FmSelCountJob, job);
+}
+
+static void _free_sel_count_report(gpointer data)
+{
+    FmSelCountReport *report = data;
+
+    _sel_count_job_unref(report->job);
+    g_slice_free(FmSelCountReport, report);
+}
+
+static void _emit_sel_status(FmTabPage* page);
+
+static gboolean on_sel_count_report(gpointer user_data)
+{
+    FmSelCountReport *report = user_data;
+    FmTabPage *page = report->job->page;
+
+    if (page == NULL) /* cancelled */
+        return FALSE;
+    page->sel_deep_size = report->size;
+    if (report->finished)
+    {
+        report->job->page = NULL;
+        _sel_count_job_unref(page->sel_count);
+        page->sel_count = NULL;
+        if (app_config->deep_count_cache && dir_size_save_id == 0 &&
+            _is_dir_size_cache_dirty())
+            dir_size_save_id = gdk_threads_add_timeout(2000, on_save_dir_size_cache, NULL);
+    }
+    _emit_sel_status(page);
+    return FALSE;
+}
+
+/* called in worker thread */
+static void _sel_count_report(FmSelCountJob *job, goffset size, gboolean finished)
+{
+    FmSelCountReport *report = g_slice_new(FmSelCountReport);
+
+    g_atomic_int_inc(&job->n_ref);
+    report->job = job;
+    report->size = size;
+    report->finished = finished;
+    gdk_threads_add_idle_full(G_PRIORITY_DEFAULT_IDLE, on_sel_count_report,
+                              report, _free_sel_count_report);
+}
+
+/* enumerates @dir, returns size of files in it and names of subfolders;
+   sets @complete to FALSE if enumeration failed in the middle */
+static char **_sel_count_list_dir(FmSelCountJob *job, GFile *dir, goffset *size,
+                                  gboolean *complete)
+{
+    GFileEnumerator *enu;
+    GFileInfo *inf;
+    GPtrArray *subdirs = g_ptr_array_new();
+    GError *err = NULL;
+
+    enu = g_file_enumerate_children(dir, G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                         G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                         G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                    job->cancellable, NULL);
+    /* unreadable folder is skipped but not cached */
+    *complete = (enu != NULL);
+    if (enu)
+    {
+        while ((inf = g_file_enumerator_next_file(enu, job->cancellable, &err)))
+        {
+            if (g_file_info_get_file_type(inf) == G_FILE_TYPE_DIRECTORY)
+                g_ptr_array_add(subdirs, g_strdup(g_file_info_get_name(inf)));
+            else
+                *size += g_file_info_get_size(inf);
+            g_object_unref(inf);
+        }
+        if (err)
+        {
+            *complete = FALSE;
+            g_error_free(err);
+        }
+        g_file_enumerator_close(enu, NULL, NULL);
+        g_object_unref(enu);
+    }
+    g_ptr_array_add(subdirs, NULL);
+    return (char **)g_ptr_array_free(subdirs, FALSE);
+}
+
+/* adds size of all files in @dir to @size, reports partial total which is
+   @base + @size once in a while; returns FALSE if cancelled */
+static gboolean _sel_count_dir(FmSelCountJob *job, GFile *dir, goffset *size,
+                               goffset base, gint64 *last_report)
+{
+    FmDirSizeEntry key, *entry;
+    gboolean has_key, complete;
+    char **subdirs = NULL, **name;
+    goffset own = 0;
+    guint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    gint64 now_us;
+
+    has_key = _get_dir_size_key(dir, &key, job->cancellable);
+    if (has_key)
+    {
+        G_LOCK(dir_size_cache);
+        entry = g_hash_table_lookup(dir_size_cache, &key);
+        if (entry)
+        {
+            own = entry->size;
+            subdirs = g_strdupv(entry->subdirs);
+            entry->used = now;
+        }
+        G_UNLOCK(dir_size_cache);
+    }
+    if (subdirs == NULL)
+    {
+        subdirs = _sel_count_list_dir(job, dir, &own, &complete);
+        if (has_key && complete)
+        {
+            entry = g_slice_new(FmDirSizeEntry);
+            *entry = key;
+            entry->size = own;
+            entry->used = now;
+            entry->subdirs = g_strdupv(subdirs);
+            G_LOCK(dir_size_cache);
+            if (g_hash_table_size(dir_size_cache) >= DIR_SIZE_CACHE_MAX)
+                _evict_dir_sizes();
+            g_hash_table_replace(dir_size_cache, entry, entry);
+            dir_size_cache_dirty = TRUE;
+            G_UNLOCK(dir_size_cache);
+        }
+    }
+    *size += own;
+    now_us = g_get_monotonic_time();
+    if (now_us - *last_report >= SEL_COUNT_REPORT_TIME * 1000)
+    {
+        _sel_count_report(job, base + *size, FALSE);
+        *last_report = now_us;
+    }
+    for (name = subdirs; *name; name++)
+    {
+        GFile *sub;
+        gboolean ok;
+
+        if (g_cancellable_is_cancelled(job->cancellable))
+            break;
+        sub = g_file_get_child(dir, *name);
+        ok = _sel_count_dir(job, sub, size, base, last_report);
+        g_object_unref(sub);
+        if (!ok)
+            break;
+    }
+    g_strfreev(subdirs);
+    return !g_cancellable_is_cancelled(job->cancellable);
+}
+
+static void _sel_count_thread(gpointer data, gpointer unused)
+{
+    FmSelCountJob *job = data;
+    GSList *l;
+    goffset total = 0, size;
+    gint64 last_report = g_get_monotonic_time();
+
+    for (l = job->dirs; l; l = l->next)
+    {
+        size = 0;
+        if (!_sel_count_dir(job, l->data, &size, total, &last_report))
+            break;
+        total += size;
+    }
+    if (!g_cancellable_is_cancelled(job->cancellable))
+        _sel_count_report(job, total, TRUE);
+    _sel_count_job_unref(job);
+}
+
+static void _cancel_sel_count(FmTabPage *page)
+{
+    if (page->sel_count)
+    {
+        g_cancellable_cancel(page->sel_count->cancellable);
+        page->sel_count->page = NULL;
+        _sel_count_job_unref(page->sel_count);
+        page->sel_count = NULL;
+    }
+    page->sel_deep_size = -1;
+}
+
+/* starts counting total size of selected folders in background */
+static void _start_sel_count(FmTabPage *page, FmFileInfoList *files)
+{
+    FmSelCountJob *job;
+    GList *l;
+
+    job = g_slice_new(FmSelCountJob);
+    job->n_ref = 2; /* one for page, one for thread */
+    job->page = page;
+    job->cancellable = g_cancellable_new();
+    job->dirs = NULL;
+    for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+    {
+        FmPath *path = fm_file_info_get_path(l->data);
+
+        /* remote folders are too expensive to walk through */
+        if (fm_file_info_is_dir(l->data) && fm_path_is_native(path))
+            job->dirs = g_slist_prepend(job->dirs, fm_path_to_gfile(path));
+    }
+    if (job->dirs == NULL)
+    {
+        g_object_unref(job->cancellable);
+        g_slice_free(FmSelCountJob, job);
+        return;
+    }
+    if (sel_count_pool == NULL)
+    {
+        _load_dir_size_cache();
+        sel_count_pool = g_thread_pool_new(_sel_count_thread, NULL,
+                                           SEL_COUNT_MAX_THREADS, FALSE, NULL);
+    }
+    page->sel_count = job;
+    page->sel_deep_size = 0;
+    g_thread_pool_push(sel_count_pool, job, NULL);
+}
+
+#if FM_CHECK_VERSION(1, 2, 0)
+/* ---------------------------------------------------------------------
+    Statusbar modules */
+
+/* delay before asynchronous modules are asked, in milliseconds */
+#define SEL_STATUS_MODULES_DELAY 150
+/* default time given to a module to reply, in milliseconds */
+#define SEL_STATUS_MODULE_TIMEOUT 1000
+
+static void _emit_sel_status(FmTabPage* page);
+
+struct _FmSelStatusRequest
+{
+    FmTabPage *page; /* NULL if selection was changed since */
+    FmFileInfoList *files; /* selection to pass to asynchronous modules */
+    char **messages; /* one per module, in order of modules */
+    guint n_modules;
+    gint refs; /* one for the page and one for each pending call */
+    guint delay_id;
+    GSList *calls; /* pending calls */
+};
+
+typedef struct
+{
+    FmSelStatusRequest *req;
+    guint idx; /* index of module */
+    GCancellable *cancellable;
+    guint timeout_id;
+} FmSelStatusCall;
+
+static void _sel_request_unref(FmSelStatusRequest *req)
+{
+    guint i;
+
+    if (--req->refs > 0)
+        return;
+    if (req->files)
+        fm_file_info_list_unref(req->files);
+    for (i = 0; i < req->n_modules; i++)
+        g_free(req->messages[i]);
+    g_free(req->messages);
+    g_slice_free(FmSelStatusRequest, req);
+}
+
+/* joins messages of modules into page->sel_extra */
+static void _update_sel_extra(FmSelStatusRequest *req)
+{
+    FmTabPage *page = req->page;
+    GString *extra = NULL;
+    guint i;
+
+    for (i = 0; i < req->n_modules; i++)
+    {
+        if (req->messages[i] == NULL || req->messages[i][0] == '\0')
+            continue;
+        if (extra == NULL)
+            extra = g_string_new(req->messages[i]);
+        else
+        {
+            g_string_append_c(extra, ' ');
+            g_string_append(extra, req->messages[i]);
+        }
+    }
+    g_free(page->sel_extra);
+    page->sel_extra = extra ? g_string_free(extra, FALSE) : NULL;
+}
+
+static gboolean _sel_status_type_match(FmFileInfo *fi, const char * const *types)
+{
+    FmMimeType *mime_type = fm_file_info_get_mime_type(fi);
+    const char *type;
+    gsize len;
+
+    if (mime_type == NULL)
+        return FALSE;
+    type = fm_mime_type_get_type(mime_type);
+    for (; *types; types++)
+    {
+        len = strlen(*types);
+        /* "image/*" matches any image type */
+        if (len > 2 && strcmp(&(*types)[len-2], "/*") == 0)
+        {
+            if (strncmp(type, *types, len - 1) == 0)
+                return TRUE;
+        }
+        else if (g_content_type_is_a(type, *types))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* returns files which @module is interested in or %NULL if there is none */
+static FmFileInfoList *_sel_status_files(FmTabPageStatusInit *module,
+                                         FmFileInfoList *files)
+{
+    FmFileInfoList *list;
+    GList *l;
+
+    if (module->mime_types == NULL)
+        return fm_file_info_list_ref(files);
+    list = fm_file_info_list_new();
+    for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+        if (_sel_status_type_match(l->data, module->mime_types))
+            fm_file_info_list_push_tail(list, l->data);
+    if (fm_file_info_list_is_empty(list))
+    {
+        fm_file_info_list_unref(list);
+        return NULL;
+    }
+    return list;
+}
+
+static void on_sel_status_ready(char *message, gpointer data)
+{
+    FmSelStatusCall *call = data;
+    FmSelStatusRequest *req = call->req;
+
+    if (call->timeout_id)
+        g_source_remove(call->timeout_id);
+    req->calls = g_slist_remove(req->calls, call);
+    /* result of cancelled or timed out call is dropped */
+    if (req->page && !g_cancellable_is_cancelled(call->cancellable))
+    {
+        g_free(req->messages[call->idx]);
+        req->messages[call->idx] = message;
+        _update_sel_extra(req);
+        _emit_sel_status(req->page);
+    }
+    else
+        g_free(message);
+    g_object_unref(call->cancellable);
+    g_slice_free(FmSelStatusCall, call);
+    _sel_request_unref(req);
+}
+
+static gboolean on_sel_status_timeout(gpointer data)
+{
+    FmSelStatusCall *call = data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    /* module is too slow, it's not worth waiting for it */
+    call->timeout_id = 0;
+    g_cancellable_cancel(call->cancellable);
+    return FALSE;
+}
+
+static gboolean on_sel_modules_delay(gpointer data)
+{
+    FmSelStatusRequest *req = data;
+    FmTabPageStatusInit *module;
+    FmSelStatusCall *call;
+    FmFileInfoList *files;
+    GList *l;
+    guint i;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    req->delay_id = 0;
+    for (l = _tab_page_modules, i = 0; l && i < req->n_modules; l = l->next, i++)
+    {
+        module = l->data;
+        if (module->sel_message_async == NULL ||
+            (files = _sel_status_files(module, req->files)) == NULL)
+            continue;
+        call = g_slice_new(FmSelStatusCall);
+        call->req = req;
+        call->idx = i;
+        call->cancellable = g_cancellable_new();
+        call->timeout_id = gdk_threads_add_timeout(module->timeout ? module->timeout
+                                                                   : SEL_STATUS_MODULE_TIMEOUT,
+                                                   on_sel_status_timeout, call);
+        req->refs++;
+        req->calls = g_slist_prepend(req->calls, call);
+        /* the module may reply right away, req is kept by the page */
+        module->sel_message_async(files, fm_file_info_list_get_length(files),
+                                  call->cancellable, on_sel_status_ready, call);
+        fm_file_info_list_unref(files);
+    }
+    return FALSE;
+}
+
+/* asks synchronous modules right away and schedules asynchronous ones,
+   those are asked only once selection is not changed for a while */
+static void _start_sel_modules(FmTabPage *page, FmFileInfoList *files)
+{
+    FmSelStatusRequest *req;
+    FmFileInfoList *list;
+    GList *l;
+    guint i;
+    gboolean need_delay = FALSE;
+
+    CHECK_MODULES();
+    if (_tab_page_modules == NULL)
+        return;
+    req = g_slice_new0(FmSelStatusRequest);
+    req->page = page;
+    req->refs = 1;
+    req->n_modules = g_list_length(_tab_page_modules);
+    req->messages = g_new0(char *, req->n_modules);
+    for (l = _tab_page_modules, i = 0; l; l = l->next, i++)
+    {
+        FmTabPageStatusInit *module = l->data;
+
+        if (module->sel_message_async)
+            need_delay = TRUE;
+        else if ((list = _sel_status_files(module, files)) != NULL)
+        {
+            req->messages[i] = module->sel_message(list,
+                                                   fm_file_info_list_get_length(list));
+            fm_file_info_list_unref(list);
+        }
+    }
+    _update_sel_extra(req);
+    if (!need_delay)
+    {
+        _sel_request_unref(req);
+        return;
+    }
+    req->files = fm_file_info_list_ref(files);
+    req->delay_id = gdk_threads_add_timeout(SEL_STATUS_MODULES_DELAY,
+                                            on_sel_modules_delay, req);
+    page->sel_request = req;
+}
+
+static void _cancel_sel_modules(FmTabPage *page)
+{
+    FmSelStatusRequest *req = page->sel_request;
+    FmSelStatusCall *call;
+    GSList *l;
+
+    if (req == NULL)
+        return;
+    page->sel_request = NULL;
+    req->page = NULL;
+    if (req->delay_id)
+        g_source_remove(req->delay_id);
+    req->delay_id = 0;
+    /* modules will reply later, replies will be dropped */
+    for (l = req->calls; l; l = l->next)
+    {
+        call = l->data;
+        if (call->timeout_id)
+            g_source_remove(call->timeout_id);
+        call->timeout_id = 0;
+        g_cancellable_cancel(call->cancellable);
+    }
+    _sel_request_unref(req);
+}
+#endif
+
+/* ---------------------------------------------------------------------
+    Selection status */
+
+/* updates selection status text from totals collected in page */
+static void _emit_sel_status(FmTabPage* page)
+{
+    char* msg = page->status_text[FM_STATUS_TEXT_SELECTED_FILES];
+    GString *str;
+    char sum_str[128];
+
+    g_free(msg);
+    str = g_string_sized_new(64);
+    if (page->sel_n == 0)
+        msg = NULL;
+    else if (page->sel_single != NULL)
+    {
+        FmFileInfo* fi = page->sel_single;
+        const char* size_str = fm_file_info_get_disp_size(fi);
+
+        if (size_str == NULL && page->sel_deep_size >= 0)
+        {
+            /* it is a folder and its size is known */
+            fm_file_size_to_str(sum_str, sizeof(sum_str), page->sel_deep_size,
+                                fm_config->si_unit);
+            size_str = sum_str;
+        }
+        if(size_str)
+        {
+            g_string_printf(str, "\"%s\" (%s) %s",
+                        fm_file_info_get_disp_name(fi),
+                        size_str ? size_str : "",
+                        fm_file_info_get_desc(fi));
+        }
+        else
+        {
+            g_string_printf(str, "\"%s\" %s",
+                        fm_file_info_get_disp_name(fi),
+                        fm_file_info_get_desc(fi));
+        }
+    }
+    else
+    {
+        g_string_printf(str, ngettext("%d item selected", "%d items selected",
+                                      page->sel_n), page->sel_n);
+        /* totals are known only after files list was scanned */
+        if (page->sel_size >= 0 && (page->sel_dirs == 0 || page->sel_deep_size >= 0))
+        {
+            fm_file_size_to_str(sum_str, sizeof(sum_str),
+                                page->sel_size + MAX(page->sel_deep_size, 0),
+                                fm_config->si_unit);
+            g_string_append_printf(str, " (%s)", sum_str);
+        }
+        else if (page->sel_size >= 0)
+        {
+            /* directories have no size unless we do deep count */
+            fm_file_size_to_str(sum_str, sizeof(sum_str), page->sel_size,
+                                fm_config->si_unit);
+            g_string_append_printf(str, " (%s, ", sum_str);
+            g_string_append_printf(str, ngettext("%d folder", "%d folders",
+                                                 page->sel_dirs),
+                                   page->sel_dirs);
+            g_string_append_c(str, ')');
+        }
+    }
+    if (page->sel_count)
+        g_string_append_printf(str, " %s", _("(counting...)"));
+    if (page->sel_extra)
+    {
+        g_string_append_c(str, ' ');
+        g_string_append(str, page->sel_extra);
+    }
+    if (page->sel_n > 0)
+        msg = g_string_free(str, FALSE);
+    else
+        g_string_free(str, TRUE);
+    page->status_text[FM_STATUS_TEXT_SELECTED_FILES] = msg;
+    g_signal_emit(page, signals[STATUS], 0,
+                  (guint)FM_STATUS_TEXT_SELECTED_FILES, msg);
+}
+
+/* resets selection totals, they will be updated later */
+static void _reset_sel_status(FmTabPage* page, gint n_sel)
+{
+    _cancel_sel_count(page);
+#if FM_CHECK_VERSION(1, 2, 0)
+    _cancel_sel_modules(page);
+#endif
+    page->sel_n = n_sel;
+    page->sel_size = -1;
+    page->sel_dirs = 0;
+    if (page->sel_single)
+        fm_file_info_unref(page->sel_single);
+    page->sel_single = NULL;
+    g_free(page->sel_extra);
+    page->sel_extra = NULL;
+}
+
+/* scans selection once and collects totals for the status text */
+static void update_sel_status(FmTabPage* page)
+{
+    FmFileInfoList* files = fm_folder_view_dup_selected_files(page->folder_view);
+    GList *l;
+
+    _reset_sel_status(page, 0);
+    page->sel_size = 0;
+    for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+    {
+        page->sel_n++;
+        if (fm_file_info_is_dir(l->data))
+            page->sel_dirs++;
+        else
+            page->sel_size += fm_file_info_get_size(l->data);
+    }
+    if (page->sel_n == 1)
+        page->sel_single = fm_file_info_ref(fm_file_info_list_peek_head(files));
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* ---- statusbar plugins support ---- */
+    if (page->sel_n > 0)
+        _start_sel_modules(page, files);
+#endif
+    if (page->sel_dirs > 0)
+        _start_sel_count(page, files);
+    /* single selected folder is likely opened next */
+    if (page->sel_single && fm_file_info_is_dir(page->sel_single))
+        _prefetch_path(page, fm_file_info_get_path(page->sel_single));
+    _emit_sel_status(page);
+    fm_file_info_list_unref(files);
+}
+
+static gboolean on_update_sel_status(gpointer user_data)
+{
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    FM_TAB_PAGE(user_data)->sel_update_id = 0;
+    update_sel_status(user_data);
+    return FALSE;
+}
+
+/* selection may be changed many times in a row (by rubber band or by
+   shift-click) so count is shown immediately but the list of selected
+   files is duplicated and scanned only once after all changes are done */
+static void on_folder_view_sel_changed(FmFolderView* fv, gint n_sel, FmTabPage* page)
+{
+    if (n_sel > 1)
+    {
+        _reset_sel_status(page, n_sel);
+        _emit_sel_status(page);
+        if (page->sel_update_id == 0)
+            page->sel_update_id = gdk_threads_add_idle_full(G_PRIORITY_LOW,
+                                                            on_update_sel_status,
+                                                            page, NULL);
+        return;
+    }
+    if (page->sel_update_id)
+    {
+        g_source_remove(page->sel_update_id);
+        page->sel_update_id = 0;
+    }
+    if (n_sel == 1)
+        update_sel_status(page);
+    else
+    {
+        _reset_sel_status(page, 0);
+        _emit_sel_status(page);
+    }
+}
+
+#if FM_CHECK_VERSION(1, 2, 0)
+static void  on_folder_view_columns_changed(FmFolderView *fv, FmTabPage *page)
+{
+    GSList *columns = fm_folder_view_get_columns(fv), *l;
+    char **cols;
+    guint i;
+
+    if (columns == NULL)
+        return;
+    i = g_slist_length(columns);
+    cols = g_new(char *, i+1);
+    for (i = 0, l = columns; l; i++, l = l->next)
+    {
+        FmFolderViewColumnInfo *info = l->data;
+
+        if (info->width > 0)
+            cols[i] = g_strdup_printf("%s:%d",
+                                      fm_folder_model_col_get_name(info->col_id),
+                                      info->width);
+        else
+            cols[i] = g_strdup(fm_folder_model_col_get_name(info->col_id));
+    }
+    g_slist_free(columns);
+    cols[i] = NULL; /* terminate the list */
+    if (page->own_config)
+    {
+        g_strfreev(page->columns);
+        page->columns = cols;
+        fm_app_config_save_config_for_path(fm_folder_view_get_cwd(fv),
+                                           page->sort_type, page->sort_by, -1,
+                                           page->show_hidden, cols);
+    }
+    else
+    {
+        g_strfreev(app_config->columns);
+        app_config->columns = cols;
+        pcmanfm_save_config(FALSE);
+    }
+}
+#endif
+
+static gboolean on_folder_view_focus_in(GtkWidget *widget, GdkEvent *event, FmTabPage *page)
+{
+    g_signal_emit(page, signals[GOT_FOCUS], 0);
+    return FALSE;
+}
+
+static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErrorSeverity severity, FmTabPage* page)
+{
+    GtkWindow* win = GTK_WINDOW(GET_MAIN_WIN(page));
+    if(err->domain == G_IO_ERROR)
+    {
+        if( err->code == G_IO_ERROR_NOT_MOUNTED && severity < FM_JOB_ERROR_CRITICAL )
+        {
+            FmPath* path = fm_folder_get_path(folder);
+            if(fm_mount_path(win, path, TRUE))
+                return FM_JOB_RETRY;
+        }
+    }
+    if(severity >= FM_JOB_ERROR_MODERATE)
+    {
+        /* Only show more severe errors to the users and
+         * ignore milder errors. Otherwise too many error
+         * message boxes can be annoying.
+         * This fixes bug #3411298- Show "Permission denied" when switching to super user mode.
+         * https://sourceforge.net/tracker/?func=detail&aid=3411298&group_id=156956&atid=801864
+         * */
+        fm_show_error(win, NULL, err->message);
+    }
+    return FM_JOB_CONTINUE;
+}
+
+#if FM_CHECK_VERSION(1, 0, 2)
+/* ---------------------------------------------------------------------
+    History snapshots */
+
+/* When page leaves a loaded folder its model is kept aside for a while so
+   going back or forward to it is only a matter of setting the model to the
+   view again. The model follows changes of the folder meanwhile so it is
+   up to date, and it is dropped if the folder is reloaded. The page filter
+   is taken off the kept model so it doesn't test files for the page while
+   page shows another folder, it is put back when the model is taken. */
+
+typedef struct
+{
+    FmTabPage *page;
+    FmFolder *folder;
+    FmFolderModel *model;
+    guint n_files; /* model keeps all files, not only rows shown */
+    FmSortMode sort_type;
+    FmFolderModelCol sort_by;
+    FmStandardViewMode view_mode;
+    gboolean show_hidden;
+    gboolean own_config;
+    char **columns; /* NULL if own_config is FALSE */
+    char *filter_pattern;
+    GSList *selected; /* FmPath */
+} FmFolderSnapshot;
+
+static GQueue snapshots = G_QUEUE_INIT; /* most recently used first */
+static guint snapshot_files = 0; /* files in all kept models */
+
+static void on_snapshot_folder_reload(FmFolder *folder, FmFolderSnapshot *snap);
+static void on_snapshot_files_added(FmFolder *folder, GSList *files, FmFolderSnapshot *snap);
+static void on_snapshot_files_removed(FmFolder *folder, GSList *files, FmFolderSnapshot *snap);
+
+static void _free_snapshot(FmFolderSnapshot *snap)
+{
+    snapshot_files -= snap->n_files;
+    g_signal_handlers_disconnect_by_func(snap->folder, on_snapshot_folder_reload, snap);
+    g_signal_handlers_disconnect_by_func(snap->folder, on_snapshot_files_added, snap);
+    g_signal_handlers_disconnect_by_func(snap->folder, on_snapshot_files_removed, snap);
+    g_object_unref(snap->model);
+    g_object_unref(snap->folder);
+    g_strfreev(snap->columns);
+    g_free(snap->filter_pattern);
+    g_slist_foreach(snap->selected, (GFunc)fm_path_unref, NULL);
+    g_slist_free(snap->selected);
+    g_slice_free(FmFolderSnapshot, snap);
+}
+
+static void on_snapshot_folder_reload(FmFolder *folder, FmFolderSnapshot *snap)
+{
+    g_queue_remove(&snapshots, snap);
+    _free_snapshot(snap);
+}
+
+/* drops least recently used models until files in them fit the limit */
+static void _trim_snapshots(void)
+{
+    while (snapshots.length > 0 &&
+           snapshot_files > (guint)app_config->history_snapshot_files)
+        _free_snapshot(g_queue_pop_tail(&snapshots));
+}
+
+/* kept models grow and shrink with their folders, keep the count exact */
+static void on_snapshot_files_added(FmFolder *folder, GSList *files, FmFolderSnapshot *snap)
+{
+    guint n = g_slist_length(files);
+
+    snap->n_files += n;
+    snapshot_files += n;
+    _trim_snapshots();
+}
+
+static void on_snapshot_files_removed(FmFolder *folder, GSList *files, FmFolderSnapshot *snap)
+{
+    guint n = MIN(g_slist_length(files), snap->n_files);
+
+    snap->n_files -= n;
+    snapshot_files -= n;
+}
+
+/* keeps current model of @page aside, dropping least recently used ones */
+static void _save_snapshot(FmTabPage *page)
+{
+    FmFolderSnapshot *snap;
+#if FM_CHECK_VERSION(1, 2, 0)
+    FmFileInfoList *files;
+    GList *l;
+#endif
+
+    if (app_config->history_snapshot_files <= 0 || page->model == NULL ||
+        page->folder == NULL || !fm_folder_is_loaded(page->folder) ||
+        fm_folder_is_incremental(page->folder) || page->batch_events != NULL
+#if FM_CHECK_VERSION(1, 2, 0)
+        || page->stale_files != NULL
+#endif
+       )
+        return;
+    snap = g_slice_new(FmFolderSnapshot);
+    snap->page = page;
+    snap->folder = g_object_ref(page->folder);
+    snap->model = g_object_ref(page->model);
+    snap->n_files = fm_file_info_list_get_length(fm_folder_get_files(page->folder));
+    snap->sort_type = page->sort_type;
+    snap->sort_by = page->sort_by;
+    snap->view_mode = fm_standard_view_get_mode(FM_STANDARD_VIEW(page->folder_view));
+    snap->show_hidden = page->show_hidden;
+    snap->own_config = page->own_config;
+    snap->columns = page->own_config ? g_strdupv(page->columns) : NULL;
+    snap->filter_pattern = g_strdup(page->filter_pattern);
+    snap->selected = NULL;
+#if FM_CHECK_VERSION(1, 2, 0)
+    files = fm_folder_view_dup_selected_files(page->folder_view);
+    if (files)
+    {
+        for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+            snap->selected = g_slist_prepend(snap->selected,
+                                             fm_path_ref(fm_file_info_get_path(l->data)));
+        fm_file_info_list_unref(files);
+    }
+#endif
+    /* rows hidden by the filter stay hidden until it is applied on take */
+    if (page->filter_pattern)
+        fm_folder_model_remove_filter(snap->model, fm_tab_page_path_filter, page);
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* it is not scored by the page anymore so sort it as page does */
+    g_object_set_qdata(G_OBJECT(snap->model), fuzzy_sort_qdata, NULL);
+#endif
+    fm_folder_model_set_sort(snap->model, page->sort_by, page->sort_type);
+    g_signal_connect(snap->folder, "start-loading",
+                     G_CALLBACK(on_snapshot_folder_reload), snap);
+    g_signal_connect(snap->folder, "files-added",
+                     G_CALLBACK(on_snapshot_files_added), snap);
+    g_signal_connect(snap->folder, "files-removed",
+                     G_CALLBACK(on_snapshot_files_removed), snap);
+    g_queue_push_head(&snapshots, snap);
+    snapshot_files += snap->n_files;
+    _trim_snapshots();
+}
+
+/* returns kept snapshot of @path for @page and removes it from the list */
+static FmFolderSnapshot *_take_snapshot(FmTabPage *page, FmPath *path)
+{
+    FmFolderSnapshot *snap;
+    GList *l;
+
+    for (l = snapshots.head; l; l = l->next)
+    {
+        snap = l->data;
+        if (snap->page == page && fm_path_equal(fm_folder_get_path(snap->folder), path))
+            break;
+    }
+    if (l == NULL)
+        return NULL;
+    g_queue_delete_link(&snapshots, l);
+    /* the filter was changed since, it's not worth to refilter */
+    if (!fm_folder_is_loaded(snap->folder) ||
+        g_strcmp0(snap->filter_pattern, page->filter_pattern) != 0)
+    {
+        _free_snapshot(snap);
+        return NULL;
+    }
+    return snap;
+}
+
+static void _drop_page_snapshots(FmTabPage *page)
+{
+    GList *l, *next;
+
+    for (l = snapshots.head; l; l = next)
+    {
+        next = l->next;
+        if (((FmFolderSnapshot*)l->data)->page == page)
+        {
+            _free_snapshot(l->data);
+            g_queue_delete_link(&snapshots, l);
+        }
+    }
+}
+#endif
+
+/* ---------------------------------------------------------------------
+    Background tabs */
+
+static gboolean on_detach_hidden(gpointer user_data)
+{
+    FmTabPage* page = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    page->detach_id = 0;
+    /* incremental folders cannot be restored from loaded files */
+    if (page->model && page->folder && fm_folder_is_loaded(page->folder)
+#if FM_CHECK_VERSION(1, 0, 2)
+        && !fm_folder_is_incremental(page->folder)
+#endif
+       )
+    {
+        _set_history_scroll_pos(page, fm_tab_page_get_scroll_pos(page));
+        _set_view_model(page, NULL);
+        page->detached = TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * fm_tab_page_set_active
+ * @page: the page instance
+ * @active: %TRUE if page is shown
+ *
+ * Hidden pages don't update status on each change of the folder, it is
+ * done once when the page is shown again. If page is hidden longer than
+ * configured time then its model is dropped and created again on show.
+ */
+void fm_tab_page_set_active(FmTabPage* page, gboolean active)
+{
+    if (page->inactive == !active)
+        return;
+    page->inactive = !active;
+    if (!active)
+    {
+#if FM_CHECK_VERSION(1, 0, 2)
+        /* queue changes of the folder instead of updating the view */
+        if (page->model && page->folder && fm_folder_is_loaded(page->folder) &&
+            !fm_folder_is_incremental(page->folder))
+        {
+            _cancel_change_storm(page);
+            _start_model_batching(page);
+        }
+#endif
+        if (app_config->detach_hidden_tabs > 0 && page->detach_id == 0)
+            page->detach_id = gdk_threads_add_timeout_seconds(app_config->detach_hidden_tabs,
+                                                              on_detach_hidden,
+                                                              page);
+        return;
+    }
+    if (page->detach_id)
+    {
+        g_source_remove(page->detach_id);
+        page->detach_id = 0;
+    }
+#if FM_CHECK_VERSION(1, 0, 2)
+    /* add changes which were queued while page was hidden */
+    if (page->resync_on_show)
+        _resync_folder_model(page);
+    else if (page->batch_events && page->batch_id == 0 && !page->storm)
+    {
+        if (!g_queue_is_empty(page->batch_events))
+            page->batch_id = gdk_threads_add_idle_full(G_PRIORITY_DEFAULT_IDLE,
+                                                       on_model_batch_idle, page, NULL);
+        else if (fm_folder_is_loaded(page->folder))
+            _stop_model_batching(page);
+    }
+#endif
+    if (page->detached)
+    {
+        page->detached = FALSE;
+        if (page->model == NULL && page->folder && fm_folder_is_loaded(page->folder))
+        {
+            _attach_folder_model(page, page->folder);
+            _queue_update_scroll(page);
+        }
+        page->status_dirty = TRUE;
+    }
+    if (page->status_dirty)
+    {
+        page->status_dirty = FALSE;
+        _resync_status_counters(page);
+        update_status_text(page);
+    }
+    if (page->fs_info_dirty && page->folder)
+    {
+        page->fs_info_dirty = FALSE;
+        on_folder_fs_info(page->folder, page);
+    }
+}
+
+/* ---------------------------------------------------------------------
+    Folders prefetch */
+
+/* max number of visited folders which visits are counted */
+#define PREFETCH_VISITS_MAX 256
+/* prefetch which isn't finished in that time (in seconds) is abandoned */
+#define PREFETCH_TIMEOUT 10
+
+static GQueue prefetched = G_QUEUE_INIT; /* FmFolder, most recent first */
+static GQueue prefetch_queue = G_QUEUE_INIT; /* FmPath to load */
+static FmFolder *prefetch_folder = NULL; /* folder being loaded now */
+static guint prefetch_timeout = 0;
+static guint prefetch_idle = 0;
+static GHashTable *prefetch_visits = NULL; /* FmPath -> number of visits */
+
+/* moves @folder to the head of cache, then drops least recently used
+   folders until cache fits into configured limits */
+static void _prefetch_keep(FmFolder *folder)
+{
+    GList *l = g_queue_find(&prefetched, folder);
+    guint n_files = 0;
+
+    if (l)
+    {
+        g_queue_unlink(&prefetched, l);
+        g_queue_push_head_link(&prefetched, l);
+    }
+    else
+        g_queue_push_head(&prefetched, g_object_ref(folder));
+    for (l = prefetched.head; l; l = l->next)
+        n_files += fm_file_info_list_get_length(fm_folder_get_files(l->data));
+    while (prefetched.length > 0 &&
+           ((gint)prefetched.length > app_config->prefetch_folders ||
+            (gint)n_files > app_config->prefetch_files))
+    {
+        folder = g_queue_pop_tail(&prefetched);
+        n_files -= fm_file_info_list_get_length(fm_folder_get_files(folder));
+        g_object_unref(folder);
+    }
+}
+
+/* stops following the folder being prefetched; the folder is freed and its
+   loading is cancelled if nobody else uses it, so if @requeue is TRUE then
+   it will be loaded again later */
+static void _prefetch_stop(gboolean requeue)
+{
+    FmFolder *folder = prefetch_folder;
+
+    if (folder == NULL)
+        return;
+    prefetch_folder = NULL;
+    if (prefetch_timeout)
+    {
+        g_source_remove(prefetch_timeout);
+        prefetch_timeout = 0;
+    }
+    g_signal_handlers_disconnect_by_func(folder, on_prefetch_finished, NULL);
+    if (requeue)
+        g_queue_push_head(&prefetch_queue, fm_path_ref(fm_folder_get_path(folder)));
+    g_object_unref(folder);
+}
+
+static void on_prefetch_finished(FmFolder *folder, gpointer unused)
+{
+    /* folder which failed to load is not worth keeping */
+    if (fm_folder_get_info(folder) != NULL)
+        _prefetch_keep(folder);
+    _prefetch_stop(FALSE);
+    _queue_prefetch();
+}
+
+/* folder is on a slow or dead mount, don't block other prefetches */
+static gboolean on_prefetch_timeout(gpointer unused)
+{
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    prefetch_timeout = 0;
+    _prefetch_stop(FALSE);
+    _queue_prefetch();
+    return FALSE;
+}
+
+static gboolean on_prefetch_idle(gpointer unused)
+{
+    FmPath *path;
+    FmFolder *folder;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    /* foreground loading has priority, it will restart us when done */
+    if (loading_pages > 0 || prefetch_folder != NULL)
+    {
+        prefetch_idle = 0;
+        return FALSE;
+    }
+    path = g_queue_pop_head(&prefetch_queue);
+    if (path == NULL)
+    {
+        prefetch_idle = 0;
+        return FALSE;
+    }
+    folder = fm_folder_from_path(path);
+    fm_path_unref(path);
+    if (fm_folder_is_loaded(folder))
+    {
+        /* it is in memory already, just keep it there */
+        _prefetch_keep(folder);
+        g_object_unref(folder);
+        return TRUE;
+    }
+    /* load only one folder at a time */
+    prefetch_folder = folder;
+    g_signal_connect(folder, "finish-loading", G_CALLBACK(on_prefetch_finished), NULL);
+    prefetch_timeout = gdk_threads_add_timeout_seconds(PREFETCH_TIMEOUT,
+                                                       on_prefetch_timeout, NULL);
+    prefetch_idle = 0;
+    return FALSE;
+}
+
+static void _queue_prefetch(void)
+{
+    if (prefetch_idle == 0 && prefetch_folder == NULL && loading_pages == 0 &&
+        prefetch_queue.length > 0)
+        prefetch_idle = gdk_threads_add_idle_full(G_PRIORITY_LOW, on_prefetch_idle,
+                                                  NULL, NULL);
+}
+
+static gboolean _prefetch_add(FmPath *path, FmPath *cwd, gboolean urgent)
+{
+    GList *l;
+
+    if (path == NULL || fm_path_equal(path, cwd) || !fm_path_is_native(path))
+        return FALSE;
+    for (l = prefetch_queue.head; l; l = l->next)
+        if (fm_path_equal(l->data, path))
+            break;
+    if (l)
+    {
+        if (!urgent)
+            return FALSE;
+        fm_path_unref(l->data);
+        g_queue_delete_link(&prefetch_queue, l);
+    }
+    if (urgent)
+        g_queue_push_head(&prefetch_queue, fm_path_ref(path));
+    else
+        g_queue_push_tail(&prefetch_queue, fm_path_ref(path));
+    return TRUE;
+}
+
+/* prefetches folder which user most likely will open next */
+static void _prefetch_path(FmTabPage *page, FmPath *path)
+{
+    if (app_config->prefetch_folders <= 0 || page->folder == NULL)
+        return;
+    if (_prefetch_add(path, fm_folder_get_path(page->folder), TRUE))
+        _queue_prefetch();
+}
+
+static gint _compare_visits(gconstpointer a, gconstpointer b)
+{
+    return GPOINTER_TO_INT(g_hash_table_lookup(prefetch_visits, b)) -
+           GPOINTER_TO_INT(g_hash_table_lookup(prefetch_visits, a));
+}
+
+static gboolean _age_visit(gpointer key, gpointer value, gpointer unused)
+{
+    return (GPOINTER_TO_INT(value) <= 1);
+}
+
+static void _prefetch_count_visit(FmPath *path)
+{
+    gint n;
+
+    if (prefetch_visits == NULL)
+        prefetch_visits = g_hash_table_new_full((GHashFunc)fm_path_hash,
+                                                (GEqualFunc)fm_path_equal,
+                                                (GDestroyNotify)fm_path_unref,
+                                                NULL);
+    n = GPOINTER_TO_INT(g_hash_table_lookup(prefetch_visits, path));
+    if (n == 0 && g_hash_table_size(prefetch_visits) >= PREFETCH_VISITS_MAX)
+    {
+        /* forget folders visited only once, or everything if there are none */
+        if (g_hash_table_foreach_remove(prefetch_visits, _age_visit, NULL) == 0)
+            g_hash_table_remove_all(prefetch_visits);
+    }
+    g_hash_table_replace(prefetch_visits, fm_path_ref(path), GINT_TO_POINTER(n + 1));
+}
+
+/* fills the queue with targets for current folder of @page: its parent,
+   previous and next folders in history, and folders near it which are
+   visited frequently */
+static void fm_tab_page_prefetch(FmTabPage *page)
+{
+    FmPath *cwd, *parent;
+    GList *frequent = NULL, *l;
+    GHashTableIter it;
+    gpointer key, value;
+    gint n = 0;
+#if FM_CHECK_VERSION(1, 0, 2)
+    guint idx;
+#else
+    const GList *link;
+#endif
+
+    if (app_config->prefetch_folders <= 0 || page->folder == NULL)
+        return;
+    cwd = fm_folder_get_path(page->folder);
+    parent = fm_path_get_parent(cwd);
+    /* targets of previous folder are not interesting anymore */
+    g_queue_foreach(&prefetch_queue, (GFunc)fm_path_unref, NULL);
+    g_queue_clear(&prefetch_queue);
+    n += _prefetch_add(parent, cwd, FALSE);
+#if FM_CHECK_VERSION(1, 0, 2)
+    idx = fm_nav_history_get_cur_index(page->nav_history);
+    n += _prefetch_add(fm_nav_history_get_nth_path(page->nav_history, idx + 1), cwd, FALSE);
+    if (idx > 0)
+        n += _prefetch_add(fm_nav_history_get_nth_path(page->nav_history, idx - 1), cwd, FALSE);
+#else
+    link = fm_nav_history_get_cur_link(page->nav_history);
+    if (link && link->next)
+        n += _prefetch_add(((FmNavHistoryItem*)link->next->data)->path, cwd, FALSE);
+    if (link && link->prev)
+        n += _prefetch_add(((FmNavHistoryItem*)link->prev->data)->path, cwd, FALSE);
+#endif
+    /* siblings and children which were visited more than once */
+    if (prefetch_visits)
+    {
+        g_hash_table_iter_init(&it, prefetch_visits);
+        while (g_hash_table_iter_next(&it, &key, &value))
+        {
+            FmPath *key_parent = fm_path_get_parent(key);
+
+            if (GPOINTER_TO_INT(value) > 1 && key_parent &&
+                (fm_path_equal(key_parent, cwd) ||
+                 (parent && fm_path_equal(key_parent, parent))))
+                frequent = g_list_prepend(frequent, key);
+        }
+        frequent = g_list_sort(frequent, _compare_visits);
+        for (l = frequent; l && n < app_config->prefetch_folders; l = l->next)
+            n += _prefetch_add(l->data, cwd, FALSE);
+        g_list_free(frequent);
+    }
+    _queue_prefetch();
+}
+
+static void fm_tab_page_realize(GtkWidget *page)
+{
+    GTK_WIDGET_CLASS(fm_tab_page_parent_class)->realize(page);
+    if (FM_TAB_PAGE(page)->busy)
+        fm_set_busy_cursor(page);
+}
+
+static void fm_tab_page_unrealize(GtkWidget *page)
+{
+    if (FM_TAB_PAGE(page)->busy)
+        fm_unset_busy_cursor(page);
+    GTK_WIDGET_CLASS(fm_tab_page_parent_class)->unrealize(page);
+}
+
+static void _tab_set_busy_cursor(FmTabPage* page)
+{
+    if (!page->busy)
+        loading_pages++;
+    page->busy = TRUE;
+    /* foreground loading has priority, prefetch will be restarted later */
+    if (prefetch_folder && prefetch_folder != page->folder)
+        _prefetch_stop(TRUE);
+    if (gtk_widget_get_realized(GTK_WIDGET(page)))
+        fm_set_busy_cursor(GTK_WIDGET(page));
+}
+
+static void _tab_unset_busy_cursor(FmTabPage* page)
+{
+    if (page->busy)
+        loading_pages--;
+    page->busy = FALSE;
+    if (gtk_widget_get_realized(GTK_WIDGET(page)))
+        fm_unset_busy_cursor(GTK_WIDGET(page));
+    _queue_prefetch();
+}
+
+#if FM_CHECK_VERSION(1, 0, 2)
+/* ---------------------------------------------------------------------
+    Filter pattern matching */
+
+typedef enum
+{
+    FILTER_MATCH_EXACT,     /* "abc" */
+    FILTER_MATCH_PREFIX,    /* "abc*" */
+    FILTER_MATCH_SUFFIX,    /* "*abc" */
+    FILTER_MATCH_SUBSTRING, /* "*abc*" */
+    FILTER_MATCH_GLOB,      /* anything else, use fnmatch() */
+    FILTER_MATCH_FUZZY      /* "~abc", matches "a*b*c*" ranked by score */
+} FmTabPageFilterType;
+
+struct _FmTabPageFilter
+{
+    FmTabPageFilterType type;
+    char *pattern; /* casefolded and normalized pattern for fnmatch() */
+    char *literal; /* pattern without leading and trailing '*' or '~' */
+    gsize len; /* strlen(literal) */
+    guint64 mask; /* FILTER_MATCH_FUZZY: bytes which key should contain */
+    guint serial; /* unique id of this filter */
+    guint prev_serial; /* serial of the filter this one replaced */
+    gboolean keep_hidden : 1; /* narrowed: rows hidden before stay hidden */
+    gboolean keep_shown : 1; /* widened: rows shown before stay shown */
+};
+
+typedef struct
+{
+    char *key; /* casefolded and normalized display name */
+    char *disp_name; /* display name the key was made of */
+    guint64 mask; /* set of bytes in the key, see _get_byte_mask() */
+    guint serial; /* serial of the filter that computed matched */
+    gboolean matched;
+    gint score; /* FILTER_MATCH_FUZZY: rank of the match */
+} FmTabPageFilterKey;
+
+/* folders with more files than that are filtered in chunks in idle */
+#define FILTER_CHUNK_THRESHOLD 2000
+/* time (in ms) for one chunk of filtering */
+#define FILTER_SLICE_TIME 8
+
+static guint filter_serial = 0;
+
+/* each byte sets one of 64 bits so if some byte of pattern is missing
+   in the key then it can be detected by single check without scanning */
+static guint64 _get_byte_mask(const char *str)
+{
+    guint64 mask = 0;
+
+    for (; *str; str++)
+        mask |= G_GUINT64_CONSTANT(1) << (*(guchar*)str & 0x3f);
+    return mask;
+}
+
+/* both pattern and keys are normalized UTF-8 so comparing literal parts
+   bytewise gives the same result as fnmatch() does but much faster */
+static FmTabPageFilter *fm_tab_page_filter_new(const char *pattern)
+{
+    FmTabPageFilter *filter = g_slice_new0(FmTabPageFilter);
+    const char *start = pattern;
+    gsize len = strlen(pattern);
+    gboolean leading = FALSE, trailing = FALSE;
+
+    filter->pattern = g_strdup(pattern);
+    filter->serial = ++filter_serial;
+    /* "\~" at start matches literal '~' */
+    if (start[0] == '\\' && start[1] == '~')
+    {
+        start++;
+        len--;
+    }
+    else if (start[0] == '~')
+    {
+        filter->type = FILTER_MATCH_FUZZY;
+        filter->literal = g_strdup(&start[1]);
+        filter->len = len - 1;
+        filter->mask = _get_byte_mask(filter->literal);
+        return filter;
+    }
+    if (len > 0 && start[0] == '*')
+    {
+        leading = TRUE;
+        start++;
+        len--;
+    }
+    if (len > 0 && start[len-1] == '*')
+    {
+        trailing = TRUE;
+        len--;
+    }
+    filter->literal = g_strndup(start, len);
+    filter->len = len;
+    if (strpbrk(filter->literal, "*?[\\") != NULL)
+        filter->type = FILTER_MATCH_GLOB;
+    else if (leading && trailing)
+        filter->type = FILTER_MATCH_SUBSTRING;
+    else if (leading)
+        filter->type = FILTER_MATCH_SUFFIX;
+    else if (trailing)
+        filter->type = FILTER_MATCH_PREFIX;
+    else
+        filter->type = FILTER_MATCH_EXACT;
+    return filter;
+}
+
+static void fm_tab_page_filter_free(FmTabPageFilter *filter)
+{
+    g_free(filter->pattern);
+    g_free(filter->literal);
+    g_slice_free(FmTabPageFilter, filter);
+}
+
+static gboolean _has_suffix(const char *str, gsize len, const char *suffix, gsize s_len)
+{
+    return (len >= s_len && memcmp(str + len - s_len, suffix, s_len) == 0);
+}
+
+#define FUZZY_BONUS_MATCH       1   /* for each matched character */
+#define FUZZY_BONUS_WORD_START  8   /* matched at start of a word */
+#define FUZZY_BONUS_CONSECUTIVE 4   /* matched right after previous match */
+
+/* matches @pattern as a subsequence of @key, compares whole UTF-8
+   characters; returns the score or -1 if there is no match */
+static gint _fuzzy_match(const char *pattern, const char *key)
+{
+    const char *k = key, *last = NULL;
+    gint score = 0;
+    guint n;
+
+    while (*pattern)
+    {
+        n = g_utf8_skip[*(guchar*)pattern];
+        /* find next occurence of the character */
+        while (*k && (*k != *pattern || strncmp(k, pattern, n) != 0))
+            k = g_utf8_next_char(k);
+        if (*k == '\0')
+            return -1;
+        score += FUZZY_BONUS_MATCH;
+        if (k == key || strchr(" -_.", k[-1]) != NULL)
+            score += FUZZY_BONUS_WORD_START;
+        if (last && k == last)
+            score += FUZZY_BONUS_CONSECUTIVE;
+        pattern += n;
+        k += n;
+        last = k;
+    }
+    return score;
+}
+
+/* returns TRUE if any name matched by @narrow is matched by @wide as well */
+static gboolean fm_tab_page_filter_is_subset(FmTabPageFilter *narrow,
+                                             FmTabPageFilter *wide)
+{
+    if (strcmp(narrow->pattern, wide->pattern) == 0)
+        return TRUE;
+    if (narrow->type == FILTER_MATCH_GLOB)
+        return FALSE;
+    if (wide->type == FILTER_MATCH_FUZZY)
+        /* literal part of narrow is a subsequence of any name it matches */
+        return (_fuzzy_match(wide->literal, narrow->literal) >= 0);
+    if (narrow->type == FILTER_MATCH_FUZZY)
+        return FALSE;
+    switch (wide->type)
+    {
+    case FILTER_MATCH_SUBSTRING:
+        /* any literal part of narrow contains it */
+        return (strstr(narrow->literal, wide->literal) != NULL);
+    case FILTER_MATCH_PREFIX:
+        return ((narrow->type == FILTER_MATCH_PREFIX ||
+                 narrow->type == FILTER_MATCH_EXACT) &&
+                strncmp(narrow->literal, wide->literal, wide->len) == 0);
+    case FILTER_MATCH_SUFFIX:
+        return ((narrow->type == FILTER_MATCH_SUFFIX ||
+                 narrow->type == FILTER_MATCH_EXACT) &&
+                _has_suffix(narrow->literal, narrow->len, wide->literal, wide->len));
+    case FILTER_MATCH_EXACT:
+    case FILTER_MATCH_GLOB:
+    case FILTER_MATCH_FUZZY:
+    default:
+        return FALSE;
+    }
+}
+
+static gboolean fm_tab_page_filter_match(FmTabPageFilter *filter,
+                                         FmTabPageFilterKey *entry)
+{
+    const char *key = entry->key;
+
+    switch (filter->type)
+    {
+    case FILTER_MATCH_EXACT:
+        return (strcmp(key, filter->literal) == 0);
+    case FILTER_MATCH_PREFIX:
+        return (strncmp(key, filter->literal, filter->len) == 0);
+    case FILTER_MATCH_SUFFIX:
+        return _has_suffix(key, strlen(key), filter->literal, filter->len);
+    case FILTER_MATCH_SUBSTRING:
+        return (strstr(key, filter->literal) != NULL);
+    case FILTER_MATCH_FUZZY:
+        if ((filter->mask & ~entry->mask) != 0)
+            return FALSE;
+        entry->score = _fuzzy_match(filter->literal, key);
+        return (entry->score >= 0);
+    case FILTER_MATCH_GLOB:
+    default:
+        return (fnmatch(filter->pattern, key, 0) == 0);
+    }
+}
+
+static void _free_filter_key(gpointer data)
+{
+    FmTabPageFilterKey *entry = data;
+
+    g_free(entry->key);
+    g_free(entry->disp_name);
+    g_slice_free(FmTabPageFilterKey, entry);
+}
+
+/* returns the entry with casefolded and normalized display name of the
+   file, the key is computed only once per file and kept until the file
+   is renamed; file info is updated in place on rename, and the model may
+   test the file before the page learns about it, so the name is compared
+   on each lookup */
+static FmTabPageFilterKey *fm_tab_page_get_filter_key(FmTabPage *page, FmFileInfo *file)
+{
+    FmTabPageFilterKey *entry;
+    const char *disp_name = fm_file_info_get_disp_name(file);
+    char *casefold;
+
+    if (page->filter_keys == NULL)
+        page->filter_keys = g_hash_table_new_full(g_direct_hash, NULL,
+                                                  (GDestroyNotify)fm_file_info_unref,
+                                                  _free_filter_key);
+    else
+    {
+        entry = g_hash_table_lookup(page->filter_keys, file);
+        if (entry && strcmp(entry->disp_name, disp_name) == 0)
+            return entry;
+    }
+    entry = g_slice_new(FmTabPageFilterKey);
+    entry->disp_name = g_strdup(disp_name);
+    casefold = g_utf8_casefold(disp_name, -1);
+    entry->key = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
+    g_free(casefold);
+    entry->mask = _get_byte_mask(entry->key);
+    entry->serial = 0;
+    entry->matched = FALSE;
+    entry->score = 0;
+    g_hash_table_replace(page->filter_keys, fm_file_info_ref(file), entry);
+    return entry;
+}
+
+/* tests the file against current filter, result for previous filter is
+   reused if the pattern was only narrowed or widened since then */
+static gboolean fm_tab_page_filter_test(FmTabPage *page, FmFileInfo *file)
+{
+    FmTabPageFilter *filter = page->filter;
+    FmTabPageFilterKey *entry = fm_tab_page_get_filter_key(page, file);
+
+    if (entry->serial == filter->serial)
+        return entry->matched;
+    if (entry->serial == 0 || entry->serial != filter->prev_serial ||
+        (entry->matched ? !filter->keep_shown : !filter->keep_hidden))
+        entry->matched = fm_tab_page_filter_match(filter, entry);
+    entry->serial = filter->serial;
+    return entry->matched;
+}
+
+#if FM_CHECK_VERSION(1, 2, 0)
+/* The column callbacks get no model so the model which is sorted or gets
+   a row is kept in sorting_model for the time of the call, and the page
+   which scores files for it is bound to it as qdata. The model calls its
+   filter right before it inserts a row, so the filter sets it as well and
+   row-inserted or row-changed handler resets it. Models which are not
+   sorted by score, i.e. not bound to a page, see no scores. */
+static FmTabPage *_get_scoring_page(void)
+{
+    return sorting_model ? g_object_get_qdata(G_OBJECT(sorting_model),
+                                              fuzzy_sort_qdata) : NULL;
+}
+
+static gint _get_fuzzy_score(FmTabPage *page, FmFileInfo *fi)
+{
+    FmTabPageFilterKey *entry;
+
+    if (page == NULL || page->filter_keys == NULL || page->filter == NULL)
+        return -1;
+    entry = g_hash_table_lookup(page->filter_keys, fi);
+    if (entry && entry->serial == page->filter->serial && entry->matched)
+        return entry->score;
+    return -1;
+}
+
+static GType _score_get_type(void)
+{
+    return G_TYPE_INT;
+}
+
+static void _score_get_value(FmFileInfo *fi, GValue *value)
+{
+    g_value_set_int(value, _get_fuzzy_score(_get_scoring_page(), fi));
+}
+
+/* compares files of equal score by sort column of the page */
+static gint _score_compare_tie(FmTabPage *page, FmFileInfo *fi1, FmFileInfo *fi2)
+{
+    FmSortMode mode = page ? page->sort_type : FM_SORT_ASCENDING;
+    FmFolderModelCol col = page ? page->sort_by : FM_FOLDER_MODEL_COL_NAME;
+    gint ret = 0;
+
+    switch (col)
+    {
+    case FM_FOLDER_MODEL_COL_SIZE:
+        if (fm_file_info_get_size(fi1) != fm_file_info_get_size(fi2))
+            ret = (fm_file_info_get_size(fi1) > fm_file_info_get_size(fi2)) ? 1 : -1;
+        break;
+    case FM_FOLDER_MODEL_COL_MTIME:
+        if (fm_file_info_get_mtime(fi1) != fm_file_info_get_mtime(fi2))
+            ret = (fm_file_info_get_mtime(fi1) > fm_file_info_get_mtime(fi2)) ? 1 : -1;
+        break;
+    case FM_FOLDER_MODEL_COL_DESC:
+        ret = g_strcmp0(fm_file_info_get_desc(fi1), fm_file_info_get_desc(fi2));
+        break;
+    default:
+        break;
+    }
+    if (ret == 0)
+    {
+        if (mode & FM_SORT_CASE_SENSITIVE)
+            ret = g_strcmp0(fm_file_info_get_collate_key_nocasefold(fi1),
+                            fm_file_info_get_collate_key_nocasefold(fi2));
+        else
+            ret = g_strcmp0(fm_file_info_get_collate_key(fi1),
+                            fm_file_info_get_collate_key(fi2));
+    }
+    return FM_SORT_IS_ASCENDING(mode) ? ret : -ret;
+}
+
+static gint _score_compare(FmFileInfo *fi1, FmFileInfo *fi2)
+{
+    FmTabPage *page = _get_scoring_page();
+    /* best matches go first */
+    gint ret = _get_fuzzy_score(page, fi2) - _get_fuzzy_score(page, fi1);
+
+    return ret ? ret : _score_compare_tie(page, fi1, fi2);
+}
+
+static FmFolderModelColumnInit score_column_init =
+{
+    NULL, /* no title so it's not offered in view columns */
+    0,
+    _score_get_type,
+    _score_get_value,
+    _score_compare
+};
+
+static void _register_score_column(void)
+{
+    if (score_column == FM_FOLDER_MODEL_COL_DEFAULT)
+        score_column = fm_folder_model_add_custom_column("fuzzy-score",
+                                                         &score_column_init);
+}
+#endif
+
+#if FM_CHECK_VERSION(1, 0, 2)
+/* shows or hides rows of @model by its filters */
+static void _apply_model_filters(FmFolderModel *model)
+{
+#if FM_CHECK_VERSION(1, 2, 0)
+    sorting_model = model;
+#endif
+    fm_folder_model_apply_filters(model);
+#if FM_CHECK_VERSION(1, 2, 0)
+    sorting_model = NULL;
+#endif
+}
+#endif
+
+/* sets sort of model from page settings, if fuzzy filter is active and
+   sort by score is enabled then that overrides page sort temporarily */
+static void fm_tab_page_update_sort(FmTabPage *page, FmFolderModel *model)
+{
+#if FM_CHECK_VERSION(1, 2, 0)
+    if (app_config->fuzzy_sort && page->filter &&
+        page->filter->type == FILTER_MATCH_FUZZY)
+    {
+        FmFolderModelCol by;
+        FmSortMode mode, old_mode;
+
+        g_object_set_qdata(G_OBJECT(model), fuzzy_sort_qdata, page);
+        mode = (page->sort_type & ~FM_SORT_ORDER_MASK) | FM_SORT_ASCENDING;
+        if (fm_folder_model_get_sort(model, &by, &old_mode) &&
+            by == score_column && old_mode == mode)
+        {
+            /* scores or tie order were changed but libfm cannot sort again
+               by the same column, so the model is created again with its
+               sort set before rows are added; cached listing and search
+               results are sorted once they are replaced or done */
+            if (model == page->model && page->folder && page->stale_files == NULL &&
+                fm_folder_is_loaded(page->folder) && !fm_folder_is_incremental(page->folder))
+                _resync_folder_model(page);
+            return;
+        }
+        sorting_model = model;
+        fm_folder_model_set_sort(model, score_column, mode);
+        sorting_model = NULL;
+        return;
+    }
+    g_object_set_qdata(G_OBJECT(model), fuzzy_sort_qdata, NULL);
+#endif
+    fm_folder_model_set_sort(model, page->sort_by, page->sort_type);
+}
+
+/* keys of renamed files are renewed by fm_tab_page_get_filter_key() */
+static void on_folder_files_changed(FmFolder *folder, GSList *files, FmTabPage *page)
+{
+    _check_folder_config_changed(folder, files);
+}
+
+static void _cancel_filter_chunks(FmTabPage *page)
+{
+    if (page->filter_idle)
+    {
+        g_source_remove(page->filter_idle);
+        page->filter_idle = 0;
+    }
+    if (page->filter_files)
+    {
+        g_ptr_array_foreach(page->filter_files, (GFunc)fm_file_info_unref, NULL);
+        g_ptr_array_free(page->filter_files, TRUE);
+        page->filter_files = NULL;
+    }
+}
+
+/* tests files in slices so typing into filter entry is not blocked and
+   refilters the model once all results are ready in the cache */
+static gboolean on_filter_idle(gpointer user_data)
+{
+    FmTabPage *page = user_data;
+    FmFolderModel *model;
+    gint64 deadline;
+    guint i;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    deadline = g_get_monotonic_time() + FILTER_SLICE_TIME * 1000;
+    for (i = 0; page->filter_pos < page->filter_files->len; i++)
+    {
+        fm_tab_page_filter_test(page, g_ptr_array_index(page->filter_files,
+                                                        page->filter_pos++));
+        if ((i & 0x3f) == 0x3f && g_get_monotonic_time() >= deadline)
+            return TRUE;
+    }
+    page->filter_idle = 0;
+    _cancel_filter_chunks(page);
+    model = fm_folder_view_get_model(page->folder_view);
+    if (model)
+    {
+        _apply_model_filters(model);
+        fm_tab_page_update_sort(page, model);
+    }
+    return FALSE;
+}
+
+/* refilters model after filter was changed, either at once for small
+   folders or after all the files were tested in idle chunks */
+static void fm_tab_page_apply_filter(FmTabPage *page, FmFolderModel *model)
+{
+    FmFolder *folder = page->folder;
+    FmFileInfoList *files;
+    GList *l;
+
+    if (page->filter == NULL || folder == NULL ||
+        (files = fm_folder_get_files(folder)) == NULL ||
+        fm_file_info_list_get_length(files) < FILTER_CHUNK_THRESHOLD)
+    {
+        _cancel_filter_chunks(page);
+        _apply_model_filters(model);
+        fm_tab_page_update_sort(page, model);
+        return;
+    }
+    /* rows shown now are tested against previous filter, that makes
+       continuation of previous run with new filter impossible */
+    page->filter_pos = 0;
+    if (page->filter_files == NULL)
+    {
+        /* take a snapshot since folder contents may change meanwhile */
+        page->filter_files = g_ptr_array_sized_new(fm_file_info_list_get_length(files));
+        for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+            g_ptr_array_add(page->filter_files, fm_file_info_ref(l->data));
+    }
+    if (page->filter_idle == 0)
+        page->filter_idle = gdk_threads_add_idle(on_filter_idle, page);
+}
+
+static gboolean fm_tab_page_path_filter(FmFileInfo *file, gpointer user_data)
+{
+    FmTabPage *page;
+
+    g_return_val_if_fail(FM_IS_TAB_PAGE(user_data), FALSE);
+    page = (FmTabPage*)user_data;
+    if (page->filter == NULL)
+        return TRUE;
+    if (!fm_tab_page_filter_test(page, file))
+        return FALSE;
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* row for the file is inserted next, see _get_fuzzy_score() */
+    if (sorting_model == NULL)
+        sorting_model = page->model;
+#endif
+    return TRUE;
+}
+#endif
+
+#if FM_CHECK_VERSION(1, 2, 0)
+/* ---------------------------------------------------------------------
+    Cached folder listings */
+
+/* folders with at least that many files are cached even if local */
+#define LISTING_CACHE_MIN_FILES 1000
+#define LISTING_CACHE_MAGIC "pcmanfm-listing 2"
+
+static char *_get_listing_cache_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "pcmanfm", "listings", NULL);
+}
+
+static char *_get_listing_cache_file(FmPath *path)
+{
+    char *str = fm_path_to_str(path);
+    char *sum = g_compute_checksum_for_string(G_CHECKSUM_MD5, str, -1);
+    char *dir = _get_listing_cache_dir();
+    char *file = g_build_filename(dir, sum, NULL);
+
+    g_free(dir);
+    g_free(sum);
+    g_free(str);
+    return file;
+}
+
+/* Listings are formatted and written by a single worker thread which also
+   owns size bookkeeping of the cache, so the directory is scanned only
+   once and then each time the cache is over its limits. */
+
+typedef struct
+{
+    FmPath *path;
+    FmFileInfoList *files; /* a reference on each file, not on folder list */
+    gint max_files;
+    goffset max_size;
+} FmListingSaveJob;
+
+typedef struct
+{
+    char *name;
+    time_t mtime;
+    goffset size;
+} FmListingCacheItem;
+
+static GThreadPool *listing_save_pool = NULL;
+/* used by the worker only; total is -1 until the directory is scanned */
+static goffset listing_cache_total = -1;
+static gint listing_cache_count = 0;
+
+static gint _compare_listing_cache_items(gconstpointer a, gconstpointer b)
+{
+    const FmListingCacheItem *item1 = a, *item2 = b;
+
+    /* most recently used first */
+    return (item1->mtime < item2->mtime) ? 1 : (item1->mtime > item2->mtime) ? -1 : 0;
+}
+
+/* removes least recently used listings until cache fits configured limits
+   and counts what is left */
+static void _evict_listing_cache(gint max_files, goffset max_size)
+{
+    char *dir_path = _get_listing_cache_dir();
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    GArray *items;
+    const char *name;
+    goffset total = 0;
+    guint i;
+
+    listing_cache_total = 0;
+    listing_cache_count = 0;
+    if (dir == NULL)
+    {
+        g_free(dir_path);
+        return;
+    }
+    items = g_array_new(FALSE, FALSE, sizeof(FmListingCacheItem));
+    while ((name = g_dir_read_name(dir)) != NULL)
+    {
+        FmListingCacheItem item;
+        struct stat st;
+
+        item.name = g_build_filename(dir_path, name, NULL);
+        if (g_stat(item.name, &st) < 0)
+        {
+            g_free(item.name);
+            continue;
+        }
+        item.mtime = st.st_mtime;
+        item.size = st.st_size;
+        g_array_append_val(items, item);
+    }
+    g_dir_close(dir);
+    g_array_sort(items, _compare_listing_cache_items);
+    for (i = 0; i < items->len; i++)
+    {
+        FmListingCacheItem *item = &g_array_index(items, FmListingCacheItem, i);
+
+        total += item->size;
+        if ((gint)i >= max_files || total > max_size)
+            g_unlink(item->name);
+        else
+        {
+            listing_cache_total = total;
+            listing_cache_count++;
+        }
+        g_free(item->name);
+    }
+    g_array_free(items, TRUE);
+    g_free(dir_path);
+}
+
+/* writes files of loaded folder into cache: escaped path of the folder,
+   then one line per file: name, display name, mode, size, mtime and MIME
+   type */
+static void _save_listing_thread(gpointer data, gpointer unused)
+{
+    FmListingSaveJob *job = data;
+    GString *buf;
+    GList *l;
+    GFile *gf;
+    struct stat st;
+    char *file, *dir, *str;
+    goffset old_size = -1;
+
+    buf = g_string_sized_new(64 * fm_file_info_list_get_length(job->files) + 64);
+    str = fm_path_to_str(job->path);
+    /* path may contain newline as any file name */
+    file = g_strescape(str, NULL);
+    g_string_append_printf(buf, LISTING_CACHE_MAGIC "\n%s\n", file);
+    g_free(file);
+    g_free(str);
+    for (l = fm_file_info_list_peek_head_link(job->files); l; l = l->next)
+    {
+        FmFileInfo *fi = l->data;
+        FmMimeType *mime_type = fm_file_info_get_mime_type(fi);
+        char *name = g_strescape(fm_path_get_basename(fm_file_info_get_path(fi)), NULL);
+        char *disp_name = g_strescape(fm_file_info_get_disp_name(fi), NULL);
+
+        g_string_append_printf(buf, "%s\t%s\t%u\t%" G_GINT64_FORMAT "\t%lu\t%s\n",
+                               name, disp_name, (guint)fm_file_info_get_mode(fi),
+                               (gint64)fm_file_info_get_size(fi),
+                               (gulong)fm_file_info_get_mtime(fi),
+                               mime_type ? fm_mime_type_get_type(mime_type)
+                                         : "application/octet-stream");
+        g_free(disp_name);
+        g_free(name);
+    }
+    dir = _get_listing_cache_dir();
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+    file = _get_listing_cache_file(job->path);
+    if (g_stat(file, &st) == 0)
+        old_size = st.st_size;
+    gf = g_file_new_for_path(file);
+    g_free(file);
+    if (g_file_replace_contents(gf, buf->str, buf->len, NULL, FALSE,
+                                G_FILE_CREATE_PRIVATE, NULL, NULL, NULL) &&
+        listing_cache_total >= 0)
+    {
+        if (old_size < 0)
+            listing_cache_count++;
+        else
+            listing_cache_total -= old_size;
+        listing_cache_total += buf->len;
+    }
+    g_object_unref(gf);
+    g_string_free(buf, TRUE);
+    if (listing_cache_total < 0 || listing_cache_total > job->max_size ||
+        listing_cache_count > job->max_files)
+        _evict_listing_cache(job->max_files, job->max_size);
+    fm_file_info_list_unref(job->files);
+    fm_path_unref(job->path);
+    g_slice_free(FmListingSaveJob, job);
+}
+
+static void _save_cached_listing(FmTabPage *page)
+{
+    FmPath *path = fm_folder_get_path(page->folder);
+    FmFileInfoList *files = fm_folder_get_files(page->folder);
+    FmListingSaveJob *job;
+    GList *l;
+
+    if (app_config->listing_cache_max <= 0 || fm_folder_is_incremental(page->folder))
+        return;
+    if (fm_path_is_native(path) &&
+        fm_file_info_list_get_length(files) < LISTING_CACHE_MIN_FILES)
+        return;
+    /* the folder list is changed in place so the worker gets own one */
+    job = g_slice_new(FmListingSaveJob);
+    job->path = fm_path_ref(path);
+    job->files = fm_file_info_list_new();
+    for (l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+        fm_file_info_list_push_tail(job->files, l->data);
+    job->max_files = app_config->listing_cache_max;
+    job->max_size = (goffset)app_config->listing_cache_size * 1024;
+    if (listing_save_pool == NULL)
+        listing_save_pool = g_thread_pool_new(_save_listing_thread, NULL, 1,
+                                              FALSE, NULL);
+    g_thread_pool_push(listing_save_pool, job, NULL);
+}
+
+static FmFileInfo *_parse_listing_line(FmPath *dir, char *line)
+{
+    char **fields = g_strsplit(line, "\t", 6);
+    FmFileInfo *fi = NULL;
+
+    if (g_strv_length(fields) == 6)
+    {
+        GFileInfo *inf = g_file_info_new();
+        char *name = g_strcompress(fields[0]);
+        char *disp_name = g_strcompress(fields[1]);
+        guint32 mode = strtoul(fields[2], NULL, 10);
+        FmPath *path = fm_path_new_child(dir, name);
+        GFile *gf = fm_path_to_gfile(path);
+
+        g_file_info_set_name(inf, name);
+        g_file_info_set_display_name(inf, disp_name);
+        if (S_ISDIR(mode) || strcmp(fields[5], "inode/directory") == 0)
+            g_file_info_set_file_type(inf, G_FILE_TYPE_DIRECTORY);
+        else if (S_ISLNK(mode))
+            g_file_info_set_file_type(inf, G_FILE_TYPE_SYMBOLIC_LINK);
+        else
+            g_file_info_set_file_type(inf, G_FILE_TYPE_REGULAR);
+        g_file_info_set_attribute_uint32(inf, G_FILE_ATTRIBUTE_UNIX_MODE, mode);
+        g_file_info_set_size(inf, g_ascii_strtoll(fields[3], NULL, 10));
+        g_file_info_set_attribute_uint64(inf, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                         g_ascii_strtoull(fields[4], NULL, 10));
+        g_file_info_set_content_type(inf, fields[5]);
+        fi = fm_file_info_new_from_g_file_data(gf, inf, path);
+        g_object_unref(gf);
+        fm_path_unref(path);
+        g_object_unref(inf);
+        g_free(disp_name);
+        g_free(name);
+    }
+    g_strfreev(fields);
+    return fi;
+}
+
+static inline gboolean _cached_listing_visible(FmTabPage *page, FmFileInfo *fi)
+{
+    if (!page->show_hidden && fm_file_info_is_hidden(fi))
+        return FALSE;
+    return fm_tab_page_path_filter(fi, page);
+}
+
+/* shows the listing saved last time while folder is being loaded, the
+   files in it are marked stale until seen by the live enumeration; the
+   ones which are seen unchanged stay shown and stay in stale_files */
+static void _load_cached_listing(FmTabPage *page, FmFolder *folder)
+{
+    FmPath *path = fm_folder_get_path(folder);
+    FmFolderModel *model;
+    GHashTable *stale_files;
+    char *file, *data, *line, *next, *str, *escaped, *header;
+    gboolean valid;
+
+    if (app_config->listing_cache_max <= 0 || fm_folder_is_incremental(folder))
+        return;
+    file = _get_listing_cache_file(path);
+    if (!g_file_get_contents(file, &data, NULL, NULL))
+    {
+        g_free(file);
+        return;
+    }
+    /* mark it as recently used */
+    g_utime(file, NULL);
+    g_free(file);
+    /* check the path too since checksums might collide */
+    str = fm_path_to_str(path);
+    escaped = g_strescape(str, NULL);
+    header = g_strdup_printf(LISTING_CACHE_MAGIC "\n%s\n", escaped);
+    valid = g_str_has_prefix(data, header);
+    line = data + strlen(header);
+    g_free(header);
+    g_free(escaped);
+    g_free(str);
+    if (!valid)
+    {
+        g_free(data);
+        return;
+    }
+    model = fm_folder_model_new(NULL, page->show_hidden);
+    fm_tab_page_update_sort(page, model);
+    stale_files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                        (GDestroyNotify)fm_file_info_unref);
+    for (; *line; line = next + 1)
+    {
+        FmFileInfo *fi;
+
+        next = strchr(line, '\n');
+        if (next == NULL)
+            break;
+        *next = '\0';
+        fi = _parse_listing_line(path, line);
+        if (fi == NULL)
+            continue;
+        g_hash_table_replace(stale_files,
+                             (gpointer)fm_path_get_basename(fm_file_info_get_path(fi)),
+                             fi);
+        if (_cached_listing_visible(page, fi))
+        {
+            sorting_model = model;
+            fm_folder_model_extra_file_add(model, fi, FM_FOLDER_MODEL_ITEM_POS_SORTED);
+            sorting_model = NULL;
+        }
+    }
+    g_free(data);
+    /* rows are added before model is set to the view since it is faster */
+    _set_view_model(page, model);
+    g_object_unref(model);
+    page->stale_files = stale_files;
+}
+
+/* forgets file of cached listing which was replaced by the real one */
+static void _drop_stale_file(FmTabPage *page, const char *name, FmFileInfo *cached)
+{
+    if (page->filter_keys)
+        g_hash_table_remove(page->filter_keys, cached);
+    g_hash_table_remove(page->stale_files, name);
+}
+
+static void _drop_stale_filter_key(gpointer name, gpointer cached, gpointer page)
+{
+    g_hash_table_remove(((FmTabPage*)page)->filter_keys, cached);
+}
+
+/* replaces stale files with ones which came from live enumeration */
+static void _reconcile_cached_listing(FmTabPage *page, GSList *files)
+{
+    GSList *l;
+
+    for (l = files; l; l = l->next)
+    {
+        FmFileInfo *fi = l->data;
+        const char *name = fm_path_get_basename(fm_file_info_get_path(fi));
+        FmFileInfo *cached = g_hash_table_lookup(page->stale_files, name);
+
+        if (cached)
+        {
+            gboolean same = (fm_file_info_get_mtime(cached) == fm_file_info_get_mtime(fi) &&
+                             fm_file_info_get_size(cached) == fm_file_info_get_size(fi) &&
+                             fm_file_info_get_mode(cached) == fm_file_info_get_mode(fi));
+
+            if (same)
+                continue;
+            fm_folder_model_extra_file_remove(page->model, cached);
+            _drop_stale_file(page, name, cached);
+        }
+        if (_cached_listing_visible(page, fi))
+            fm_folder_model_extra_file_add(page->model, fi, FM_FOLDER_MODEL_ITEM_POS_SORTED);
+    }
+}
+
+static void on_folder_loaded_save_listing(FmFolder *folder, FmTabPage *page)
+{
+    _save_cached_listing(page);
+}
+
+/* ---------------------------------------------------------------------
+    Differential reload */
+
+/* Reload of loaded folder doesn't drop its listing but enumerates the
+   folder again in background and reports only differences to FmFolder,
+   so the model is updated in place and selection and scroll are kept. */
+
+#define REVALIDATE_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+                              G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+/* number of files to get from enumerator at once */
+#define REVALIDATE_CHUNK 256
+
+struct _FmRevalidate
+{
+    FmTabPage *page; /* NULL if cancelled */
+    FmFolder *folder;
+    GFile *gf;
+    GCancellable *cancellable;
+    GHashTable *unseen; /* name -> FmFileInfo not enumerated yet */
+    GSList *added; /* FmPath */
+    GSList *changed; /* FmPath */
+    time_t mtime; /* of the folder */
+    time_t start_time;
+    gint64 trace_start;
+};
+
+static void _revalidate_free(FmRevalidate *rv)
+{
+    if (rv->page)
+        rv->page->revalidate = NULL;
+    g_object_unref(rv->folder);
+    g_object_unref(rv->gf);
+    g_object_unref(rv->cancellable);
+    if (rv->unseen)
+        g_hash_table_destroy(rv->unseen);
+    g_slist_free_full(rv->added, (GDestroyNotify)fm_path_unref);
+    g_slist_free_full(rv->changed, (GDestroyNotify)fm_path_unref);
+    g_slice_free(FmRevalidate, rv);
+}
+
+static void _cancel_revalidate(FmTabPage *page)
+{
+    if (page->revalidate)
+    {
+        /* callback will free it */
+        page->revalidate->page = NULL;
+        g_cancellable_cancel(page->revalidate->cancellable);
+        page->revalidate = NULL;
+    }
+}
+
+/* differential reload failed, do it the old way */
+static void _revalidate_failed(FmRevalidate *rv, GError *err)
+{
+    FmTabPage *page = rv->page;
+
+    if (page != NULL && !g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        _revalidate_free(rv);
+        fm_folder_reload(page->folder);
+        return;
+    }
+    _revalidate_free(rv);
+}
+
+/* listing of the folder is valid now, remember it for the fast path */
+static void _revalidate_done(FmRevalidate *rv, guint n_diff, const char *detail)
+{
+    FmTabPage *page = rv->page;
+
+    page->listing_mtime = rv->mtime;
+    page->listing_time = rv->start_time;
+    pcmanfm_trace_span("revalidate", page, rv->trace_start, n_diff, detail);
+    _revalidate_free(rv);
+}
+
+/* reports differences to the folder which will update its files and
+   emit signals for them as it does for changes seen by its monitor;
+   _fm_folder_event_file_*() are exported by libfm 1.2 to let file
+   operations report changes which monitor may miss, and this is the
+   same case */
+static void _revalidate_apply(FmRevalidate *rv)
+{
+    GHashTableIter it;
+    gpointer fi;
+    GSList *l;
+    guint n_diff = 0;
+
+    g_hash_table_iter_init(&it, rv->unseen);
+    while (g_hash_table_iter_next(&it, NULL, &fi))
+    {
+        _fm_folder_event_file_deleted(rv->folder, fm_file_info_get_path(fi));
+        n_diff++;
+    }
+    for (l = rv->added; l; l = l->next, n_diff++)
+        _fm_folder_event_file_added(rv->folder, l->data);
+    for (l = rv->changed; l; l = l->next, n_diff++)
+        _fm_folder_event_file_changed(rv->folder, l->data);
+    _revalidate_done(rv, n_diff, NULL);
+}
+
+static void on_revalidate_next_files(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    GFileEnumerator *en = G_FILE_ENUMERATOR(source);
+    FmRevalidate *rv = user_data;
+    GError *err = NULL;
+    GList *infos, *l;
+    FmPath *dir;
+
+    infos = g_file_enumerator_next_files_finish(en, res, &err);
+    if (err)
+    {
+        _revalidate_failed(rv, err);
+        g_error_free(err);
+        g_file_enumerator_close_async(en, G_PRIORITY_LOW, NULL, NULL, NULL);
+        g_object_unref(en);
+        return;
+    }
+    if (rv->page == NULL || infos == NULL)
+    {
+        g_list_free_full(infos, g_object_unref);
+        g_file_enumerator_close_async(en, G_PRIORITY_LOW, NULL, NULL, NULL);
+        g_object_unref(en);
+        /* all files are enumerated unless cancelled */
+        if (rv->page)
+            _revalidate_apply(rv);
+        else
+            _revalidate_free(rv);
+        return;
+    }
+    dir = fm_folder_get_path(rv->folder);
+    for (l = infos; l; l = l->next)
+    {
+        GFileInfo *inf = l->data;
+        const char *name = g_file_info_get_name(inf);
+        FmFileInfo *fi = g_hash_table_lookup(rv->unseen, name);
+
+        if (fi == NULL)
+            rv->added = g_slist_prepend(rv->added, fm_path_new_child(dir, name));
+        else
+        {
+            if ((time_t)g_file_info_get_attribute_uint64(inf, G_FILE_ATTRIBUTE_TIME_MODIFIED)
+                    != fm_file_info_get_mtime(fi) ||
+                (goffset)g_file_info_get_size(inf) != fm_file_info_get_size(fi))
+                rv->changed = g_slist_prepend(rv->changed,
+                                              fm_path_ref(fm_file_info_get_path(fi)));
+            g_hash_table_remove(rv->unseen, name);
+        }
+        g_object_unref(inf);
+    }
+    g_list_free(infos);
+    g_file_enumerator_next_files_async(en, REVALIDATE_CHUNK, G_PRIORITY_LOW,
+                                       rv->cancellable, on_revalidate_next_files, rv);
+}
+
+static void on_revalidate_enumerate(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    FmRevalidate *rv = user_data;
+    GError *err = NULL;
+    GFileEnumerator *en = g_file_enumerate_children_finish(rv->gf, res, &err);
+
+    if (en == NULL)
+    {
+        _revalidate_failed(rv, err);
+        g_error_free(err);
+        return;
+    }
+    g_file_enumerator_next_files_async(en, REVALIDATE_CHUNK, G_PRIORITY_LOW,
+                                       rv->cancellable, on_revalidate_next_files, rv);
+}
+
+/* enumerates the folder and compares result with files of the folder */
+static void _revalidate_compare(FmRevalidate *rv)
+{
+    GList *l;
+
+    /* folder may drop its files while we enumerate so keep references */
+    rv->unseen = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                       (GDestroyNotify)fm_file_info_unref);
+    for (l = fm_file_info_list_peek_head_link(fm_folder_get_files(rv->folder));
+         l; l = l->next)
+        g_hash_table_insert(rv->unseen,
+                            (gpointer)fm_path_get_basename(fm_file_info_get_path(l->data)),
+                            fm_file_info_ref(l->data));
+    g_file_enumerate_children_async(rv->gf, REVALIDATE_ATTRIBUTES,
+                                    G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW,
+                                    rv->cancellable, on_revalidate_enumerate, rv);
+}
+
+/* filesystems which update mtime of folder on each creation, deletion or
+   rename in it; network and FUSE ones may not do that reliably */
+static const char *mtime_reliable_fs[] = {
+    "ext2", "ext3", "ext4", "xfs", "btrfs", "f2fs", "jfs", "reiserfs",
+    "tmpfs", "ramfs", NULL
+};
+
+/* returns TRUE if changes of files in place in @gf are reported */
+static gboolean _is_folder_monitored(GFile *gf)
+{
+    /* FmFolder gets its monitor from the same cache */
+    GFileMonitor *mon = fm_monitor_lookup_monitor(gf);
+    gboolean result = FALSE;
+
+    if (mon)
+    {
+        result = !g_file_monitor_is_cancelled(mon);
+        g_object_unref(mon);
+    }
+    return result;
+}
+
+static void on_revalidate_fs_info(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    FmRevalidate *rv = user_data;
+    GFileInfo *inf = g_file_query_filesystem_info_finish(rv->gf, res, NULL);
+    const char *fs_type;
+    gboolean reliable = FALSE;
+    guint i;
+
+    if (rv->page == NULL)
+    {
+        if (inf)
+            g_object_unref(inf);
+        _revalidate_free(rv);
+        return;
+    }
+    if (inf)
+    {
+        fs_type = g_file_info_get_attribute_string(inf, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE);
+        for (i = 0; fs_type && mtime_reliable_fs[i]; i++)
+            if (strcmp(fs_type, mtime_reliable_fs[i]) == 0)
+            {
+                reliable = TRUE;
+                break;
+            }
+        g_object_unref(inf);
+    }
+    /* changes of files in place are seen only by the folder monitor */
+    if (reliable && _is_folder_monitored(rv->gf))
+        _revalidate_done(rv, 0, "unchanged");
+    else
+        _revalidate_compare(rv);
+}
+
+static void on_revalidate_dir_info(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    FmRevalidate *rv = user_data;
+    GError *err = NULL;
+    GFileInfo *inf = g_file_query_info_finish(rv->gf, res, &err);
+    FmTabPage *page = rv->page;
+
+    if (inf == NULL)
+    {
+        _revalidate_failed(rv, err);
+        g_error_free(err);
+        return;
+    }
+    if (page == NULL)
+    {
+        g_object_unref(inf);
+        _revalidate_free(rv);
+        return;
+    }
+    rv->mtime = g_file_info_get_attribute_uint64(inf, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    g_object_unref(inf);
+    /* unchanged mtime of folder means nothing was created, deleted or
+       renamed in it if the filesystem updates it reliably; mtime in the
+       same second as listing may be not final */
+    if (fm_path_is_native(fm_folder_get_path(rv->folder)) && rv->mtime != 0 &&
+        rv->mtime == page->listing_mtime && rv->mtime < page->listing_time)
+        g_file_query_filesystem_info_async(rv->gf, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE,
+                                           G_PRIORITY_DEFAULT, rv->cancellable,
+                                           on_revalidate_fs_info, rv);
+    else
+        _revalidate_compare(rv);
 }
 
-#if FM_CHECK_VERSION(1, 0, 2)
-static gboolean fm_tab_page_path_filter(FmFileInfo *file, gpointer user_data)
+static void _start_revalidate(FmTabPage *page)
 {
-    FmTabPage *page;
-    const char *disp_name;
-    char *casefold, *key;
-    gboolean result;
-
-    g_return_val_if_fail(FM_IS_TAB_PAGE(user_data), FALSE);
-    page = (FmTabPage*)user_data;
-    if (page->filter_pattern == NULL)
-        return TRUE;
-    disp_name = fm_file_info_get_disp_name(file);
-    casefold = g_utf8_casefold(disp_name, -1);
-    key = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
-    g_free(casefold);
-    result = (fnmatch(page->filter_pattern, key, 0) == 0);
-    g_free(key);
-    return result;
+    FmRevalidate *rv = g_slice_new0(FmRevalidate);
+
+    _cancel_revalidate(page);
+    rv->page = page;
+    rv->folder = g_object_ref(page->folder);
+    rv->gf = fm_path_to_gfile(fm_folder_get_path(page->folder));
+    rv->cancellable = g_cancellable_new();
+    rv->start_time = time(NULL);
+    rv->trace_start = pcmanfm_trace_now();
+    page->revalidate = rv;
+    g_file_query_info_async(rv->gf, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                            G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+                            rv->cancellable, on_revalidate_dir_info, rv);
 }
-#endif
+#endif /* FM_CHECK_VERSION(1, 2, 0) */
 
 static void on_folder_start_loading(FmFolder* folder, FmTabPage* page)
 {
-    FmFolderView* fv = page->folder_view;
     /* g_debug("start-loading"); */
+    page->trace_load = pcmanfm_trace_now();
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* folder is loaded from scratch anyway */
+    _cancel_revalidate(page);
+    page->listing_time = time(NULL);
+#endif
     /* FIXME: this should be set on toplevel parent */
     _tab_set_busy_cursor(page);
 
@@ -599,35 +3711,135 @@ static void on_folder_start_loading(FmFolder* folder, FmTabPage* page)
         if (page->filter_pattern)
         {
             fm_folder_model_add_filter(model, fm_tab_page_path_filter, page);
-            fm_folder_model_apply_filters(model);
+            _apply_model_filters(model);
         }
-        fm_folder_view_set_model(fv, model);
-        fm_folder_model_set_sort(model, page->sort_by, page->sort_type);
+        _set_view_model(page, model);
+        fm_tab_page_update_sort(page, model);
         g_object_unref(model);
+        /* results may come in thousands, add them once per frame */
+        _start_model_batching(page);
     }
     else
 #endif
-        fm_folder_view_set_model(fv, NULL);
+    {
+        _set_view_model(page, NULL);
+#if FM_CHECK_VERSION(1, 2, 0)
+        if (!fm_folder_is_loaded(folder))
+            _load_cached_listing(page, folder);
+#endif
+#if FM_CHECK_VERSION(1, 0, 2)
+        if (page->progressive_id)
+            g_source_remove(page->progressive_id);
+        page->progressive_id = gdk_threads_add_timeout(PROGRESSIVE_LOAD_DELAY,
+                                                       on_progressive_load, page);
+#endif
+    }
 }
 
-static gboolean update_scroll(gpointer data)
+typedef struct
 {
-    FmTabPage* page = data;
-    GtkScrolledWindow* scroll;
-#if !FM_CHECK_VERSION(1, 0, 2)
-    const FmNavHistoryItem* item;
-#endif
+    FmTabPage *page;
+    guint serial; /* of navigation which is traced */
+} FmTraceFrame;
+
+static void _free_trace_frame(gpointer data)
+{
+    FmTraceFrame *frame = data;
+
+    g_object_unref(frame->page);
+    g_slice_free(FmTraceFrame, frame);
+}
+
+static gboolean on_trace_first_frame(gpointer user_data)
+{
+    FmTraceFrame *frame = user_data;
+    FmTabPage* page = frame->page;
+    FmPath *path;
+    char *path_str;
+    gint n_files;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    /* the page went to another folder meanwhile, that one isn't drawn yet */
+    if (frame->serial != page->trace_serial)
+        return FALSE;
+    path = fm_tab_page_get_cwd(page);
+    path_str = path ? fm_path_to_str(path) : NULL;
+    pcmanfm_trace_span("first frame", page, page->trace_scroll, -1, NULL);
+    /* rows may be filtered, the span is for the whole folder */
+    n_files = page->folder ? (gint)fm_file_info_list_get_length(fm_folder_get_files(page->folder)) : -1;
+    pcmanfm_trace_span("chdir", page, page->trace_chdir, n_files, path_str);
+    page->trace_chdir = 0;
+    g_free(path_str);
+    return FALSE;
+}
+
+/* max time (in ms) to wait for the view to grow to the scroll position */
+#define SCROLL_RESTORE_TIMEOUT 1000
+
+static void on_scroll_adjustment_changed(GtkAdjustment *adj, FmTabPage *page);
+
+static void _cancel_scroll_restore(FmTabPage *page)
+{
+    if (page->scroll_wait_id)
+    {
+        g_source_remove(page->scroll_wait_id);
+        page->scroll_wait_id = 0;
+    }
+    if (page->scroll_adj)
+    {
+        g_signal_handlers_disconnect_by_func(page->scroll_adj,
+                                             on_scroll_adjustment_changed, page);
+        g_object_unref(page->scroll_adj);
+        page->scroll_adj = NULL;
+    }
+}
+
+static void on_scroll_adjustment_changed(GtkAdjustment *adj, FmTabPage *page)
+{
+    gtk_adjustment_set_value(adj, page->scroll_target);
+    if (gtk_adjustment_get_upper(adj) - gtk_adjustment_get_page_size(adj)
+            >= page->scroll_target)
+        _cancel_scroll_restore(page);
+}
 
+static gboolean on_scroll_restore_timeout(gpointer user_data)
+{
     if (g_source_is_destroyed(g_main_current_source()))
         return FALSE;
-    scroll = GTK_SCROLLED_WINDOW(page->folder_view);
+    FM_TAB_PAGE(user_data)->scroll_wait_id = 0;
+    _cancel_scroll_restore(user_data);
+    return FALSE;
+}
+
+/* rows are measured by the view on allocation, which with GTK+ 3 is done
+   right before drawing, so the adjustment might be too small yet for the
+   position; then it is set again each time the adjustment grows */
+static void _restore_scroll_pos(FmTabPage *page, gdouble pos)
+{
+    GtkAdjustment *adj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view));
+
+    _cancel_scroll_restore(page);
+    gtk_adjustment_set_value(adj, pos);
+    if (gtk_adjustment_get_upper(adj) - gtk_adjustment_get_page_size(adj) >= pos)
+        return;
+    page->scroll_target = pos;
+    page->scroll_adj = g_object_ref(adj);
+    g_signal_connect(adj, "changed", G_CALLBACK(on_scroll_adjustment_changed), page);
+    page->scroll_wait_id = gdk_threads_add_timeout(SCROLL_RESTORE_TIMEOUT,
+                                                   on_scroll_restore_timeout, page);
+}
+
+static void _update_scroll(FmTabPage* page)
+{
 #if !FM_CHECK_VERSION(1, 0, 2)
+    const FmNavHistoryItem* item;
+
     item = fm_nav_history_get_cur(page->nav_history);
     /* scroll to recorded position */
-    gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(scroll), item->scroll_pos);
+    _restore_scroll_pos(page, item->scroll_pos);
 #else
-    gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(scroll),
-                             fm_nav_history_get_scroll_pos(page->nav_history));
+    _restore_scroll_pos(page, fm_nav_history_get_scroll_pos(page->nav_history));
 #endif
 #if FM_CHECK_VERSION(1, 2, 0)
     if (page->want_focus)
@@ -638,14 +3850,95 @@ static gboolean update_scroll(gpointer data)
         page->want_focus = NULL;
     }
 #endif
-    page->update_scroll_id = 0;
+    pcmanfm_trace_span("scroll restore", page, page->trace_scroll, -1, NULL);
+    if (page->trace_chdir)
+    {
+        FmTraceFrame *frame = g_slice_new(FmTraceFrame);
+
+        frame->page = g_object_ref(page);
+        frame->serial = page->trace_serial;
+        /* the idle runs right after redraw of the view is done */
+        page->trace_scroll = pcmanfm_trace_now();
+        gdk_threads_add_idle_full(GDK_PRIORITY_REDRAW + 1, on_trace_first_frame,
+                                  frame, _free_trace_frame);
+    }
+}
+
+static gboolean update_scroll(gpointer data)
+{
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    FM_TAB_PAGE(data)->update_scroll_id = 0;
+    _update_scroll(data);
     return FALSE;
 }
 
+/* creates a model for the folder and sets it to the view */
+static void _attach_folder_model(FmTabPage* page, FmFolder* folder)
+{
+#if FM_CHECK_VERSION(1, 0, 2)
+    /* filter and sort are set before files are added so rows are sorted
+       only once and filtered rows are never added */
+    FmFolderModel* model = fm_folder_model_new(NULL, page->show_hidden);
+
+    if (page->filter_pattern)
+        fm_folder_model_add_filter(model, fm_tab_page_path_filter, page);
+    /* since 1.0.2 sorting should be applied on model instead of view */
+    fm_tab_page_update_sort(page, model);
+#if FM_CHECK_VERSION(1, 2, 0)
+    sorting_model = model;
+#endif
+    fm_folder_model_set_folder(model, folder);
+#if FM_CHECK_VERSION(1, 2, 0)
+    sorting_model = NULL;
+#endif
+#else
+    FmFolderModel* model = fm_folder_model_new(folder, page->show_hidden);
+#endif
+
+    _set_view_model(page, model);
+    g_object_unref(model);
+}
+
+static void _queue_update_scroll(FmTabPage* page)
+{
+    page->trace_scroll = pcmanfm_trace_now();
+    /* delaying scrolling since drawing folder view is delayed */
+    if (page->update_scroll_id)
+        g_source_remove(page->update_scroll_id);
+    page->update_scroll_id = gdk_threads_add_timeout(50, update_scroll, page);
+}
+
 static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
 {
     FmFolderView* fv = page->folder_view;
 
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (page->progressive_id)
+    {
+        g_source_remove(page->progressive_id);
+        page->progressive_id = 0;
+    }
+    /* rows were added progressively, let the model follow the folder now;
+       hidden page does that when shown */
+    if (page->batch_events && page->batch_id == 0 && !page->storm && !page->inactive)
+    {
+        if (g_queue_is_empty(page->batch_events))
+        {
+            pcmanfm_trace_span("rows shown", page, page->trace_load, page->n_shown, NULL);
+            _stop_model_batching(page);
+        }
+        else /* the rest was waiting for more rows to come */
+            page->batch_id = gdk_threads_add_idle_full(G_PRIORITY_DEFAULT_IDLE,
+                                                       on_model_batch_idle, page, NULL);
+    }
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* cached listing is replaced with the real one now */
+    if (page->stale_files)
+        _set_view_model(page, NULL);
+#endif
+
     /* Note: most of the time, we delay the creation of the 
      * folder model and do it after the whole folder is loaded.
      * That is because adding rows into model is much faster when no handlers
@@ -653,41 +3946,42 @@ static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
      * and create the model again when it's fully loaded. 
      * This optimization, however, is not used for FmFolder objects
      * with incremental loading (search://) */
-    if(fm_folder_view_get_model(fv) == NULL)
-    {
-        /* create a model for the folder and set it to the view */
-        FmFolderModel* model = fm_folder_model_new(folder, page->show_hidden);
-        fm_folder_view_set_model(fv, model);
-#if FM_CHECK_VERSION(1, 0, 2)
-        if (page->filter_pattern)
-        {
-            fm_folder_model_add_filter(model, fm_tab_page_path_filter, page);
-            fm_folder_model_apply_filters(model);
-        }
-        /* since 1.0.2 sorting should be applied on model instead of view */
-        fm_folder_model_set_sort(model, page->sort_by, page->sort_type);
+    pcmanfm_trace_span("folder loading", page, page->trace_load,
+                       fm_file_info_list_get_length(fm_folder_get_files(folder)),
+                       NULL);
+#if FM_CHECK_VERSION(1, 2, 0)
+    page->listing_mtime = fm_folder_get_info(folder) ?
+                          fm_file_info_get_mtime(fm_folder_get_info(folder)) : 0;
 #endif
-        g_object_unref(model);
+    if(fm_folder_view_get_model(fv) == NULL && !page->detached)
+    {
+        gint64 trace_start = pcmanfm_trace_now();
+
+        _attach_folder_model(page, folder);
+        pcmanfm_trace_span("model creation", page, trace_start,
+                           page->n_shown, NULL);
     }
     fm_folder_query_filesystem_info(folder); /* FIXME: is this needed? */
 
     // fm_path_entry_set_path(entry, path);
-    /* delaying scrolling since drawing folder view is delayed */
-    if (page->update_scroll_id)
-        g_source_remove(page->update_scroll_id);
-    page->update_scroll_id = gdk_threads_add_timeout(50, update_scroll, page);
+#if FM_CHECK_VERSION(1, 0, 2)
+    /* position would be clamped by partial list of rows */
+    if (page->batch_events && !page->storm)
+        page->scroll_after_batch = TRUE;
+    else
+#endif
+    _queue_update_scroll(page);
 
     /* update status bar */
-    /* update status text */
-    g_free(page->status_text[FM_STATUS_TEXT_NORMAL]);
-    page->status_text[FM_STATUS_TEXT_NORMAL] = format_status_text(page);
-    g_signal_emit(page, signals[STATUS], 0,
-                  (guint)FM_STATUS_TEXT_NORMAL,
-                  page->status_text[FM_STATUS_TEXT_NORMAL]);
+    /* counters might miss something while loading so recount them */
+    _resync_status_counters(page);
+    update_status_text(page);
 
     _tab_unset_busy_cursor(page);
     /* g_debug("finish-loading"); */
     g_signal_emit(page, signals[LOADED], 0);
+    /* foreground is done, now warm up folders user may go to next */
+    fm_tab_page_prefetch(page);
 }
 
 static void on_folder_unmount(FmFolder* folder, FmTabPage* page)
@@ -729,7 +4023,15 @@ static void on_folder_removed(FmFolder* folder, FmTabPage* page)
 static void on_folder_fs_info(FmFolder* folder, FmTabPage* page)
 {
     guint64 free, total;
-    char* msg = page->status_text[FM_STATUS_TEXT_FS_INFO];
+    char* msg;
+
+    /* hidden page will update it once when shown */
+    if (page->inactive)
+    {
+        page->fs_info_dirty = TRUE;
+        return;
+    }
+    msg = page->status_text[FM_STATUS_TEXT_FS_INFO];
     g_free(msg);
     /* g_debug("%p, fs-info: %d", folder, (int)folder->has_fs_info); */
     if(fm_folder_get_filesystem_info(folder, &total, &free))
@@ -749,19 +4051,28 @@ static void on_folder_fs_info(FmFolder* folder, FmTabPage* page)
 
 static char* format_status_text(FmTabPage* page)
 {
-    FmFolderModel* model = fm_folder_view_get_model(page->folder_view);
-    FmFolder* folder = fm_folder_view_get_folder(page->folder_view);
-    if(model && folder)
+    if(page->model && page->folder)
     {
-        FmFileInfoList* files = fm_folder_get_files(folder);
         GString* msg = g_string_sized_new(128);
-        int total_files = fm_file_info_list_get_length(files);
-        int shown_files = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(model), NULL);
+        int total_files = page->n_files;
+        int shown_files = page->n_shown;
         int hidden_files = total_files - shown_files;
         const char* visible_fmt = ngettext("%d item", "%d items", shown_files);
         const char* hidden_fmt = ngettext(" (%d hidden)", " (%d hidden)", hidden_files);
 
         g_string_append_printf(msg, visible_fmt, shown_files);
+#if FM_CHECK_VERSION(1, 2, 0)
+        /* counters are not valid for cached listing */
+        if (page->stale_files)
+            g_string_append(msg, _(" (cached, updating)"));
+        else
+#endif
+#if FM_CHECK_VERSION(1, 0, 2)
+        /* counters are updated only periodically */
+        if (page->storm)
+            g_string_append(msg, _(" (live updating)"));
+        else
+#endif
         if(hidden_files > 0)
             g_string_append_printf(msg, hidden_fmt, hidden_files);
         return g_string_free(msg, FALSE);
@@ -997,6 +4308,28 @@ static void fm_tab_page_init(FmTabPage *page)
     page->busy = FALSE;
 }
 
+static void _update_tab_label(FmTabPage* page, FmPath* path)
+{
+    char* disp_name = fm_path_display_basename(path);
+    char *disp_path;
+
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (page->filter_pattern && page->filter_pattern[0])
+    {
+        /* include pattern into page title */
+        char *text = g_strdup_printf("%s [%s]", disp_name, page->filter_pattern);
+        g_free(disp_name);
+        disp_name = text;
+    }
+#endif
+    fm_tab_label_set_text(page->tab_label, disp_name);
+    g_free(disp_name);
+
+    disp_path = fm_path_display_name(path, FALSE);
+    fm_tab_label_set_tooltip_text(FM_TAB_LABEL(page->tab_label), disp_path);
+    g_free(disp_path);
+}
+
 FmTabPage *fm_tab_page_new(FmPath* path)
 {
     FmTabPage* page = (FmTabPage*)g_object_new(FM_TYPE_TAB_PAGE, NULL);
@@ -1005,28 +4338,82 @@ FmTabPage *fm_tab_page_new(FmPath* path)
     return page;
 }
 
+/* stores scroll position for current folder in history */
+static void _set_history_scroll_pos(FmTabPage* page, int scroll_pos)
+{
+#if FM_CHECK_VERSION(1, 0, 2)
+    int idx = fm_nav_history_get_cur_index(page->nav_history);
+    fm_nav_history_go_to(page->nav_history, idx, scroll_pos);
+#else
+    FmNavHistoryItem* item = (FmNavHistoryItem*)fm_nav_history_get_cur(page->nav_history);
+    /* NOTE: ignoring const modifier due to invalid pre-1.0.2 design */
+    item->scroll_pos = scroll_pos;
+#endif
+}
+
+/**
+ * fm_tab_page_new_lazy
+ * @path: the folder to open
+ * @scroll_pos: vertical scroll position to restore
+ *
+ * Creates new page which shows only label and doesn't load the folder
+ * until fm_tab_page_load_pending() is called on it. This way restoring
+ * many tabs costs not much more than opening one.
+ *
+ * Returns: (transfer full): new page.
+ */
+FmTabPage *fm_tab_page_new_lazy(FmPath* path, gint scroll_pos)
+{
+    FmTabPage* page = (FmTabPage*)g_object_new(FM_TYPE_TAB_PAGE, NULL);
+
+    page->pending_path = fm_path_ref(path);
+    page->pending_scroll = scroll_pos;
+    _update_tab_label(page, path);
+    return page;
+}
+
+/**
+ * fm_tab_page_load_pending
+ * @page: the page instance
+ *
+ * Opens folder of @page if it was created by fm_tab_page_new_lazy() and
+ * was not opened yet.
+ *
+ * Returns: %TRUE if folder loading was started.
+ */
+gboolean fm_tab_page_load_pending(FmTabPage* page)
+{
+    FmPath *path = page->pending_path;
+
+    if (path == NULL)
+        return FALSE;
+    page->pending_path = NULL;
+    fm_nav_history_chdir(page->nav_history, path, 0);
+    /* update_scroll() will take the position from history */
+    _set_history_scroll_pos(page, page->pending_scroll);
+    fm_tab_page_chdir_without_history(page, path);
+    fm_path_unref(path);
+    return TRUE;
+}
+
 static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
 {
-    char* disp_name = fm_path_display_basename(path);
-    char *disp_path;
     FmStandardViewMode view_mode;
     gboolean show_hidden;
     char **columns; /* unused with libfm < 1.0.2 */
+    gint64 trace_start;
+#if FM_CHECK_VERSION(1, 0, 2)
+    FmFolderSnapshot *snap = NULL;
+#endif
 #if FM_CHECK_VERSION(1, 2, 0)
     FmPath *prev_path = NULL;
+    GSList *l;
 #endif
 
-#if FM_CHECK_VERSION(1, 0, 2)
-    if (page->filter_pattern && page->filter_pattern[0])
-    {
-        /* include pattern into page title */
-        char *text = g_strdup_printf("%s [%s]", disp_name, page->filter_pattern);
-        g_free(disp_name);
-        disp_name = text;
-    }
-#endif
-    fm_tab_label_set_text(page->tab_label, disp_name);
-    g_free(disp_name);
+    /* the whole chdir span is finished when first frame is drawn */
+    page->trace_chdir = pcmanfm_trace_now();
+    page->trace_serial++;
+    _update_tab_label(page, path);
 
 #if FM_CHECK_VERSION(1, 2, 0)
     if (app_config->focus_previous && page->folder)
@@ -1039,12 +4426,18 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
     }
 #endif
 
-    disp_path = fm_path_display_name(path, FALSE);
-    fm_tab_label_set_tooltip_text(FM_TAB_LABEL(page->tab_label), disp_path);
-    g_free(disp_path);
+#if FM_CHECK_VERSION(1, 0, 2)
+    /* keep current folder for going back and take the new one if kept */
+    if (page->folder == NULL || !fm_path_equal(fm_folder_get_path(page->folder), path))
+    {
+        snap = _take_snapshot(page, path);
+        _save_snapshot(page);
+    }
+#endif
 
     free_folder(page);
 
+    _prefetch_count_visit(path);
     page->folder = fm_folder_from_path(path);
     g_signal_connect(page->folder, "start-loading", G_CALLBACK(on_folder_start_loading), page);
     g_signal_connect(page->folder, "finish-loading", G_CALLBACK(on_folder_finish_loading), page);
@@ -1054,16 +4447,43 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
     g_signal_connect(page->folder, "removed", G_CALLBACK(on_folder_removed), page);
     g_signal_connect(page->folder, "unmount", G_CALLBACK(on_folder_unmount), page);
     g_signal_connect(page->folder, "content-changed", G_CALLBACK(on_folder_content_changed), page);
+    g_signal_connect(page->folder, "files-added", G_CALLBACK(on_folder_files_added), page);
+    g_signal_connect(page->folder, "files-removed", G_CALLBACK(on_folder_files_removed), page);
+#if FM_CHECK_VERSION(1, 0, 2)
+    /* drop cached filter keys of changed and deleted files */
+    g_signal_connect(page->folder, "files-changed", G_CALLBACK(on_folder_files_changed), page);
+    g_signal_connect(page->folder, "files-removed", G_CALLBACK(on_folder_files_changed), page);
+    /* queue changes while model is updated in batches */
+    g_signal_connect(page->folder, "files-changed", G_CALLBACK(on_batch_files_changed), page);
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    /* update cached listing each time the folder is loaded */
+    g_signal_connect(page->folder, "finish-loading", G_CALLBACK(on_folder_loaded_save_listing), page);
+#endif
 
 #if FM_CHECK_VERSION(1, 2, 0)
     page->want_focus = prev_path;
 #endif
 
     /* get sort and view modes for new path */
-    page->own_config = fm_app_config_get_config_for_path(path, &page->sort_type,
-                                                         &page->sort_by,
-                                                         &view_mode,
-                                                         &show_hidden, &columns);
+    trace_start = pcmanfm_trace_now();
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (snap)
+    {
+        page->own_config = snap->own_config;
+        page->sort_type = snap->sort_type;
+        page->sort_by = snap->sort_by;
+        view_mode = snap->view_mode;
+        show_hidden = snap->show_hidden;
+        columns = snap->own_config ? snap->columns : app_config->columns;
+    }
+    else
+#endif
+        page->own_config = fm_app_config_get_config_for_path(path, &page->sort_type,
+                                                             &page->sort_by,
+                                                             &view_mode,
+                                                             &show_hidden, &columns);
+    pcmanfm_trace_span("config lookup", page, trace_start, -1, NULL);
     if (!page->own_config)
         /* bug #3615242: view mode is reset to default when changing directory */
         view_mode = page->view_mode;
@@ -1072,7 +4492,23 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
        show_hidden is different: we have to apply folder to the view first */
     g_signal_handlers_block_matched(page->folder_view, G_SIGNAL_MATCH_DETAIL, 0,
                                     g_quark_try_string("filter-changed"), NULL, NULL, NULL);
-    on_folder_start_loading(page->folder, page);
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (snap)
+    {
+        /* the model is up to date, there is nothing to wait for */
+        page->trace_load = pcmanfm_trace_now();
+        if (page->filter_pattern)
+        {
+            /* files were changed while the filter was off */
+            fm_folder_model_add_filter(snap->model, fm_tab_page_path_filter, page);
+            _apply_model_filters(snap->model);
+        }
+        _set_view_model(page, snap->model);
+        fm_tab_page_update_sort(page, snap->model);
+    }
+    else
+#endif
+        on_folder_start_loading(page->folder, page);
     fm_folder_view_set_show_hidden(page->folder_view, show_hidden);
 #if FM_CHECK_VERSION(1, 2, 0)
     fm_side_pane_set_show_hidden(page->side_pane, show_hidden);
@@ -1134,6 +4570,26 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
     fm_folder_view_sort(page->folder_view, page->sort_type, page->sort_by);
 #endif
 
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (snap)
+    {
+#if FM_CHECK_VERSION(1, 2, 0)
+        for (l = snap->selected; l; l = l->next)
+            fm_folder_view_select_file_path(page->folder_view, l->data);
+#endif
+        /* rows are there already so scroll is restored as soon as the view
+           measures them, before it is drawn first time */
+        if (page->update_scroll_id)
+        {
+            g_source_remove(page->update_scroll_id);
+            page->update_scroll_id = 0;
+        }
+        page->trace_scroll = pcmanfm_trace_now();
+        _update_scroll(page);
+        _free_snapshot(snap);
+    }
+#endif
+
     fm_side_pane_chdir(page->side_pane, path);
 
     /* tell the world that our current working directory is changed */
@@ -1145,8 +4601,20 @@ void fm_tab_page_chdir(FmTabPage* page, FmPath* path)
     FmPath* cwd = fm_tab_page_get_cwd(page);
     int scroll_pos;
     if(cwd && path && fm_path_equal(cwd, path))
+    {
+        fm_tab_page_load_pending(page);
         return;
-    scroll_pos = gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view)));
+    }
+    if (page->pending_path)
+    {
+        /* keep pending folder in history but don't load it */
+        fm_nav_history_chdir(page->nav_history, page->pending_path, 0);
+        scroll_pos = page->pending_scroll;
+        fm_path_unref(page->pending_path);
+        page->pending_path = NULL;
+    }
+    else
+        scroll_pos = fm_tab_page_get_scroll_pos(page);
     fm_nav_history_chdir(page->nav_history, path, scroll_pos);
     fm_tab_page_chdir_without_history(page, path);
 }
@@ -1158,18 +4626,26 @@ void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden)
     fm_side_pane_set_show_hidden(page->side_pane, show_hidden);
 #endif
     /* update status text */
-    g_free(page->status_text[FM_STATUS_TEXT_NORMAL]);
-    page->status_text[FM_STATUS_TEXT_NORMAL] = format_status_text(page);
-    g_signal_emit(page, signals[STATUS], 0,
-                  (guint)FM_STATUS_TEXT_NORMAL,
-                  page->status_text[FM_STATUS_TEXT_NORMAL]);
+    update_status_text(page);
 }
 
 FmPath* fm_tab_page_get_cwd(FmTabPage* page)
 {
+    if (page->pending_path)
+        return page->pending_path;
     return page->folder ? fm_folder_get_path(page->folder) : NULL;
 }
 
+gint fm_tab_page_get_scroll_pos(FmTabPage* page)
+{
+    GtkAdjustment* vadjustment;
+
+    if (page->pending_path)
+        return page->pending_scroll;
+    vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view));
+    return gtk_adjustment_get_value(vadjustment);
+}
+
 FmSidePane* fm_tab_page_get_side_pane(FmTabPage* page)
 {
     return page->side_pane;
@@ -1272,18 +4748,23 @@ void fm_tab_page_reload(FmTabPage* page)
 {
     FmFolder* folder = fm_folder_view_get_folder(page->folder_view);
 
+    /* model of cached listing has no folder */
+    if (folder == NULL)
+        folder = page->folder;
     if(folder)
     {
         GtkAdjustment* vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view));
         int scroll_pos = gtk_adjustment_get_value(vadjustment);
         /* save the scroll position before reload */
-#if FM_CHECK_VERSION(1, 0, 2)
-        int idx = fm_nav_history_get_cur_index(page->nav_history);
-        fm_nav_history_go_to(page->nav_history, idx, scroll_pos);
-#else
-        FmNavHistoryItem* item = (FmNavHistoryItem*)fm_nav_history_get_cur(page->nav_history);
-        /* NOTE: ignoring const modifier due to invalid pre-1.0.2 design */
-        item->scroll_pos = scroll_pos;
+        _set_history_scroll_pos(page, scroll_pos);
+#if FM_CHECK_VERSION(1, 2, 0)
+        /* loaded listing is just updated, see _start_revalidate() */
+        if (folder == page->folder && fm_folder_is_loaded(folder) &&
+            !fm_folder_is_incremental(folder))
+        {
+            _start_revalidate(page);
+            return;
+        }
 #endif
         fm_folder_reload(folder);
     }
@@ -1427,14 +4908,36 @@ void fm_tab_page_set_filter_pattern(FmTabPage *page, const char *pattern)
     if (pattern)
     {
         char *casefold = g_utf8_casefold(pattern, -1);
+        FmTabPageFilter *filter;
+
         page->filter_pattern = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
         g_free(casefold);
+        filter = fm_tab_page_filter_new(page->filter_pattern);
+        if (page->filter)
+        {
+            /* if the pattern was only extended then rows hidden before
+               cannot match now, and if it was shortened then rows shown
+               before still match, only the rest should be tested */
+            filter->prev_serial = page->filter->serial;
+            filter->keep_hidden = fm_tab_page_filter_is_subset(filter, page->filter);
+            /* fuzzy matches should be scored again */
+            filter->keep_shown = (filter->type != FILTER_MATCH_FUZZY &&
+                                  fm_tab_page_filter_is_subset(page->filter, filter));
+            fm_tab_page_filter_free(page->filter);
+        }
+        page->filter = filter;
     }
     else
+    {
         page->filter_pattern = NULL;
+        if (page->filter)
+            fm_tab_page_filter_free(page->filter);
+        page->filter = NULL;
+        _cancel_filter_chunks(page);
+    }
     /* apply changes if needed */
     if (model)
-        fm_folder_model_apply_filters(model);
+        fm_tab_page_apply_filter(page, model);
     /* update tab page title */
     disp_name = fm_path_display_basename(fm_folder_view_get_cwd(page->folder_view));
     if (page->filter_pattern)
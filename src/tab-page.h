@@ -50,6 +50,14 @@ typedef enum {
 
 typedef struct _FmTabPage            FmTabPage;
 typedef struct _FmTabPageClass        FmTabPageClass;
+typedef struct _FmSelCountJob        FmSelCountJob;
+#if FM_CHECK_VERSION(1, 2, 0)
+typedef struct _FmSelStatusRequest   FmSelStatusRequest;
+typedef struct _FmRevalidate         FmRevalidate;
+#endif
+#if FM_CHECK_VERSION(1, 0, 2)
+typedef struct _FmTabPageFilter      FmTabPageFilter;
+#endif
 
 struct _FmTabPage
 {
@@ -64,6 +72,10 @@ struct _FmTabPage
     FmDndDest *dd; /* handler for drop on label */
 #if FM_CHECK_VERSION(1, 2, 0)
     FmPath *want_focus;
+    GHashTable *stale_files; /* name -> cached FmFileInfo which is shown */
+    FmRevalidate *revalidate; /* differential reload in progress */
+    time_t listing_mtime; /* folder mtime when the listing was known valid */
+    time_t listing_time; /* when the listing was known valid */
 #endif
     /* Use sort_type, sort_by, show_hidden to setup model after folder loading */
 #if FM_CHECK_VERSION(1, 0, 2)
@@ -71,6 +83,17 @@ struct _FmTabPage
     FmFolderModelCol sort_by;
     char **columns; /* NULL if own_config is FALSE */
     char *filter_pattern;
+    FmTabPageFilter *filter; /* compiled filter_pattern */
+    GHashTable *filter_keys; /* FmFileInfo -> cached key and match result */
+    GPtrArray *filter_files; /* snapshot of folder files being filtered */
+    guint filter_pos; /* next file in filter_files to test */
+    guint filter_idle;
+    GQueue *batch_events; /* folder changes to add into model, see tab-page.c */
+    guint batch_id;
+    guint progressive_id;
+    gdouble change_rate; /* decaying count of folder changes, see tab-page.c */
+    gint64 changes_time; /* when change_rate was updated last */
+    guint storm_id;
 #else
     GtkSortType sort_type;
     int sort_by;
@@ -78,8 +101,43 @@ struct _FmTabPage
     guint view_mode;
     gboolean show_hidden : 1;
     gboolean own_config : 1;
-    gboolean busy : 1;
+    gboolean busy : 1; /* counted in loading pages for prefetch */
+    gboolean inactive : 1; /* page is hidden, status is updated when shown */
+    gboolean status_dirty : 1;
+    gboolean fs_info_dirty : 1;
+    gboolean detached : 1; /* model was dropped while page was hidden */
+    gboolean storm : 1; /* folder changes too often, model is synced periodically */
+    gboolean scroll_after_batch : 1; /* restore scroll when queued rows are added */
+    gboolean resync_on_show : 1; /* too many changes were queued while hidden */
+    guint detach_id;
     guint update_scroll_id;
+    GtkAdjustment *scroll_adj; /* waited to grow to set scroll_target */
+    gdouble scroll_target;
+    guint scroll_wait_id;
+    FmPath *pending_path; /* folder to open when page is shown first time */
+    gint pending_scroll; /* scroll position to restore in pending_path */
+    /* counters for status text */
+    FmFolderModel *model; /* the model set to folder_view */
+    gint n_files; /* files in folder */
+    gint n_shown; /* rows in model */
+    guint update_status_id;
+    /* selection totals for status text */
+    gint sel_n;
+    guint sel_dirs;
+    goffset sel_size; /* size of selected files, -1 if not counted yet */
+    goffset sel_deep_size; /* size of selected folders, -1 if unknown */
+    FmFileInfo *sel_single; /* the file if only one is selected */
+    char *sel_extra; /* additions from statusbar modules */
+    FmSelCountJob *sel_count; /* deep count in progress */
+    guint sel_update_id;
+#if FM_CHECK_VERSION(1, 2, 0)
+    FmSelStatusRequest *sel_request; /* statusbar modules are working */
+#endif
+    /* start times of traced navigation steps, 0 if not traced */
+    gint64 trace_chdir;
+    gint64 trace_load;
+    gint64 trace_scroll;
+    guint trace_serial; /* incremented on each traced chdir */
 };
 
 struct _FmTabPageClass
@@ -100,12 +158,22 @@ GType fm_tab_page_get_type(void);
 
 FmTabPage* fm_tab_page_new(FmPath* path);
 
+/* create a page which opens the folder only when shown first time */
+FmTabPage* fm_tab_page_new_lazy(FmPath* path, gint scroll_pos);
+
+/* open the folder of page created by fm_tab_page_new_lazy() */
+gboolean fm_tab_page_load_pending(FmTabPage* page);
+
 void fm_tab_page_chdir(FmTabPage* page, FmPath* path);
 
 void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden);
 
 FmPath* fm_tab_page_get_cwd(FmTabPage* page);
 
+gint fm_tab_page_get_scroll_pos(FmTabPage* page);
+
+void fm_tab_page_set_active(FmTabPage* page, gboolean active);
+
 FmSidePane* fm_tab_page_get_side_pane(FmTabPage* page);
 
 FmFolderView* fm_tab_page_get_folder_view(FmTabPage* page);
@@ -144,6 +212,8 @@ FmFolderView *fm_tab_page_get_passive_view(FmTabPage *page);
 void fm_tab_page_set_filter_pattern(FmTabPage *page, const char *pattern);
 #endif
 
+void fm_tab_page_save_caches(void);
+
 #if FM_CHECK_VERSION(1, 2, 0)
 #include "pcmanfm-modules.h"
 